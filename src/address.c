@@ -0,0 +1,96 @@
+#include "address.h"
+#include "socket.h"
+#include "inet.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/un.h>
+
+/**
+ * The length covers exactly the name: a path with its terminating NUL, an
+ * abstract name without any padding, since every byte of it is significant
+ * to the kernel. An empty address asks the kernel to autobind.
+ */
+static int gs_addr_parse_unix(struct gs_addr_t *address, const char *text)
+{
+    struct sockaddr_un *unix_address = (struct sockaddr_un *)&address->storage;
+    const size_t length = strlen(text);
+    const bool abstract = (text[0] == '@');
+
+    if ((length > sizeof(unix_address->sun_path)) || (!abstract && (length == sizeof(unix_address->sun_path)))) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    memset(unix_address, 0, sizeof(struct sockaddr_un));
+    unix_address->sun_family = AF_UNIX;
+    memcpy(unix_address->sun_path, text, length);
+
+    if (abstract) {
+        unix_address->sun_path[0] = '\0';
+        address->length = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + length);
+    }
+    else if (length) {
+        address->length = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + length + 1);
+    }
+    else {
+        address->length = (socklen_t)offsetof(struct sockaddr_un, sun_path);
+    }
+
+    return 0;
+}
+
+int gs_addr_parse(struct gs_addr_t *address, GS_SOCKET_DOMAIN_TYPE domain, const char *text)
+{
+    if (!text) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    const size_t length = strlen(text);
+
+    if (length >= sizeof(address->text)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    address->domain = domain;
+    memcpy(address->text, text, length + 1);
+
+    switch (domain) {
+        case GS_SOCKET_DOMAIN_TCP:
+        case GS_SOCKET_DOMAIN_UDP:
+            return gs_inet_parse(text, &address->storage, &address->length);
+        case GS_SOCKET_DOMAIN_UNIX:
+        case GS_SOCKET_DOMAIN_UNIX_DGRAM:
+        case GS_SOCKET_DOMAIN_UNIX_SEQPACKET:
+            return gs_addr_parse_unix(address, text);
+        default:
+            errno = EINVAL;
+            return -1;
+    }
+}
+
+struct gs_addr_t * gs_addr_resolve(GS_SOCKET_DOMAIN_TYPE domain, const char *text)
+{
+    struct gs_addr_t *address = (struct gs_addr_t *)malloc(sizeof(struct gs_addr_t));
+
+    if (!address) {
+        return NULL;
+    }
+
+    if (gs_addr_parse(address, domain, text) < 0) {
+        free(address);
+        return NULL;
+    }
+
+    return address;
+}
+
+void gs_addr_destroy(struct gs_addr_t *address)
+{
+    free(address);
+}
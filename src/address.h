@@ -0,0 +1,27 @@
+#ifndef GS_ADDRESS_H_
+#define GS_ADDRESS_H_
+
+#include "domain.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct gs_addr_t;
+
+/**
+ * Parses an address once for repeated use with gs_bind_addr() and
+ * gs_connect_addr(). TCP and UDP take "a.b.c.d:port" or "[v6]:port", the
+ * UNIX domains a path or an "@abstract" name. An abstract name is passed
+ * with its exact length, so it matches what other programs bind; "" binds
+ * to a unique abstract name chosen by the kernel.
+ */
+struct gs_addr_t * gs_addr_resolve(GS_SOCKET_DOMAIN_TYPE domain, const char *address);
+
+void gs_addr_destroy(struct gs_addr_t *address);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* GS_ADDRESS_H_ */
@@ -0,0 +1,269 @@
+#include "buffer_pool.h"
+#include "gs.h"
+#include "queue.h"
+#include "socket.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+/* Keeps every buffer on its own cache lines. */
+#define GS_BUFFER_ALIGNMENT 64
+
+struct gs_buffer_slab_t
+{
+    void *memory;
+    size_t size;
+    struct gs_buffer_t *buffers;
+};
+
+struct gs_buffer_pool_t
+{
+    unsigned int buffer_size;
+    unsigned int capacity;
+    unsigned int buffers_per_slab;
+    size_t slab_size;
+
+    /* Released buffers, taking and returning one does not lock. */
+    struct gs_queue_t *free;
+
+    /* Guards growing. */
+    pthread_mutex_t lock;
+    unsigned int buffers;
+    unsigned int slabs_size;
+    unsigned int slabs_capacity;
+    struct gs_buffer_slab_t *slabs;
+};
+
+static void * gs_buffer_slab_map(size_t size)
+{
+    void *memory = MAP_FAILED;
+
+    if ((size % GS_BUFFER_SLAB_SIZE) == 0) {
+        memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+
+    if (memory != MAP_FAILED) {
+        return memory;
+    }
+
+    /* No huge pages reserved, transparent ones are the next best thing. */
+    memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (memory == MAP_FAILED) {
+        return NULL;
+    }
+
+#ifdef MADV_HUGEPAGE
+    madvise(memory, size, MADV_HUGEPAGE);
+#endif
+
+    return memory;
+}
+
+/* Maps one more slab and returns its first buffer, the others go to the free queue. Called locked. */
+static struct gs_buffer_t * gs_buffer_pool_map_slab(struct gs_buffer_pool_t *pool)
+{
+    if (pool->slabs_size == pool->slabs_capacity) {
+        errno = ENOBUFS;
+        return NULL;
+    }
+
+    unsigned int count = pool->capacity - pool->buffers;
+
+    if (count > pool->buffers_per_slab) {
+        count = pool->buffers_per_slab;
+    }
+
+    struct gs_buffer_slab_t *slab = &pool->slabs[pool->slabs_size];
+
+    slab->size = ((((size_t)count * pool->buffer_size) + pool->slab_size - 1) / pool->slab_size) * pool->slab_size;
+    slab->memory = gs_buffer_slab_map(slab->size);
+    slab->buffers = (struct gs_buffer_t *)calloc(count, sizeof(struct gs_buffer_t));
+
+    if (!slab->memory || !slab->buffers) {
+        if (slab->memory) {
+            munmap(slab->memory, slab->size);
+        }
+
+        free(slab->buffers);
+        slab->memory = NULL;
+        slab->buffers = NULL;
+
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    for (unsigned int index = 0; index < count; ++index) {
+        slab->buffers[index].data = (char *)slab->memory + ((size_t)index * pool->buffer_size);
+        slab->buffers[index].pool = pool;
+
+        if (index) {
+            gs_queue_push(pool->free, &slab->buffers[index]);
+        }
+    }
+
+    pool->buffers += count;
+    ++pool->slabs_size;
+
+    return &slab->buffers[0];
+}
+
+static struct gs_buffer_t * gs_buffer_pool_grow(struct gs_buffer_pool_t *pool)
+{
+    void *item = NULL;
+    struct gs_buffer_t *buffer = NULL;
+
+    pthread_mutex_lock(&pool->lock);
+
+    /* Another thread may have grown the pool meanwhile. */
+    if (gs_queue_pop(pool->free, &item) == 0) {
+        buffer = (struct gs_buffer_t *)item;
+    }
+    else {
+        buffer = gs_buffer_pool_map_slab(pool);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+
+    return buffer;
+}
+
+static struct gs_buffer_t * gs_buffer_pool_acquire(struct gs_buffer_pool_t *pool)
+{
+    void *item = NULL;
+    struct gs_buffer_t *buffer = NULL;
+
+    if (gs_queue_pop(pool->free, &item) == 0) {
+        buffer = (struct gs_buffer_t *)item;
+    }
+    else {
+        buffer = gs_buffer_pool_grow(pool);
+    }
+
+    if (buffer) {
+        buffer->length = 0;
+        __atomic_store_n(&buffer->refs, 1, __ATOMIC_RELAXED);
+    }
+
+    return buffer;
+}
+
+struct gs_buffer_pool_t * gs_buffer_pool_create(unsigned int buffer_size, unsigned int capacity)
+{
+    if (!buffer_size || !capacity || (buffer_size > GS_BUFFER_SLAB_SIZE)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    struct gs_buffer_pool_t *pool = (struct gs_buffer_pool_t *)calloc(1, sizeof(struct gs_buffer_pool_t));
+
+    if (!pool) {
+        return NULL;
+    }
+
+    pool->buffer_size = (buffer_size + GS_BUFFER_ALIGNMENT - 1) & ~(GS_BUFFER_ALIGNMENT - 1);
+    pool->capacity = capacity;
+    pool->buffers_per_slab = GS_BUFFER_SLAB_SIZE / pool->buffer_size;
+
+    /* A pool smaller than a slab is not worth a huge page, whole pages will do. */
+    if ((size_t)capacity * pool->buffer_size < GS_BUFFER_SLAB_SIZE) {
+        pool->slab_size = (size_t)sysconf(_SC_PAGESIZE);
+    }
+    else {
+        pool->slab_size = GS_BUFFER_SLAB_SIZE;
+    }
+
+    pool->slabs_capacity = (capacity + pool->buffers_per_slab - 1) / pool->buffers_per_slab;
+    pool->slabs = (struct gs_buffer_slab_t *)calloc(pool->slabs_capacity, sizeof(struct gs_buffer_slab_t));
+    pool->free = gs_queue_create(capacity);
+
+    pthread_mutex_init(&pool->lock, NULL);
+
+    if (!pool->slabs || !pool->free) {
+        gs_buffer_pool_destroy(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+void gs_buffer_pool_destroy(struct gs_buffer_pool_t *pool)
+{
+    if (!pool) {
+        return;
+    }
+
+    for (unsigned int index = 0; index < pool->slabs_size; ++index) {
+        munmap(pool->slabs[index].memory, pool->slabs[index].size);
+        free(pool->slabs[index].buffers);
+    }
+
+    if (pool->free) {
+        gs_queue_destroy(pool->free);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+
+    free(pool->slabs);
+    free(pool);
+}
+
+int gs_recv_pooled(struct gs_socket_t *gsocket, struct gs_buffer_pool_t *pool, struct gs_buffer_t **buffer, int flags)
+{
+    const bool block = !((flags & MSG_DONTWAIT) || (gsocket->flags & GS_SOCKET_FLAG_NONBLOCK));
+
+    *buffer = NULL;
+
+    while (true) {
+        if (block) {
+            char byte = 0;
+
+            /* Sleeps until there is something to read, without a buffer held. */
+            const int bytes = gsocket->base->recv(gsocket, &byte, 1, flags | MSG_PEEK);
+
+            if (bytes <= 0) {
+                return bytes;
+            }
+        }
+
+        struct gs_buffer_t *borrowed = gs_buffer_pool_acquire(pool);
+
+        if (!borrowed) {
+            return -1;
+        }
+
+        const int bytes = gs_recv(gsocket, borrowed->data, pool->buffer_size, flags | MSG_DONTWAIT);
+
+        if (bytes > 0) {
+            borrowed->length = (unsigned int)bytes;
+            *buffer = borrowed;
+            return bytes;
+        }
+
+        const int error = errno;
+
+        gs_buffer_release(borrowed);
+        errno = error;
+
+        /* Another reader took the data between the peek and the read. */
+        if (!block || (bytes == 0) || ((errno != EAGAIN) && (errno != EWOULDBLOCK))) {
+            return bytes;
+        }
+    }
+}
+
+void gs_buffer_ref(struct gs_buffer_t *buffer)
+{
+    __atomic_add_fetch(&buffer->refs, 1, __ATOMIC_RELAXED);
+}
+
+void gs_buffer_release(struct gs_buffer_t *buffer)
+{
+    if (__atomic_sub_fetch(&buffer->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        gs_queue_push(buffer->pool->free, buffer);
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef GS_BUFFER_POOL_H_
+#define GS_BUFFER_POOL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct gs_socket_t;
+struct gs_buffer_pool_t;
+
+/* Buffers are carved from slabs of this size, backed by huge pages when some are reserved. */
+#define GS_BUFFER_SLAB_SIZE (2 * 1024 * 1024)
+
+/* A fixed-size slice of a pool slab, shared by reference counting. */
+struct gs_buffer_t
+{
+    void *data;
+
+    /* Bytes received into `data`. */
+    unsigned int length;
+
+    /* Private. */
+    unsigned int refs;
+    struct gs_buffer_pool_t *pool;
+};
+
+/**
+ * Creates a pool of at most `capacity` buffers of `buffer_size` bytes.
+ * Slabs are mapped the first time their buffers are needed and kept until
+ * the pool is destroyed, so the memory used follows the number of buffers
+ * in flight at the peak rather than the number of connections.
+ */
+struct gs_buffer_pool_t * gs_buffer_pool_create(unsigned int buffer_size, unsigned int capacity);
+
+/* Every buffer must have been released. */
+void gs_buffer_pool_destroy(struct gs_buffer_pool_t *pool);
+
+/**
+ * gs_recv() into a buffer that is borrowed from `pool` only once data has
+ * arrived: a blocking call waits without holding one, and a non-blocking
+ * call that would block hands it back at once. On success `*buffer` holds
+ * the bytes and one reference owned by the caller. Returns 0 on EOF, and
+ * -1 with errno ENOBUFS when the pool is exhausted, both without a buffer.
+ */
+int gs_recv_pooled(struct gs_socket_t *gsocket, struct gs_buffer_pool_t *pool, struct gs_buffer_t **buffer, int flags);
+
+/* Takes another reference, e.g. before handing the data to another thread. */
+void gs_buffer_ref(struct gs_buffer_t *buffer);
+
+/* Drops a reference, the last one returns the buffer to its pool. Safe to call from any thread. */
+void gs_buffer_release(struct gs_buffer_t *buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* GS_BUFFER_POOL_H_ */
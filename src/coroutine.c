@@ -0,0 +1,370 @@
+#include "coroutine.h"
+#include "gs.h"
+#include "socket.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+
+/* Default-sized stacks kept per thread for the next coroutines. */
+#define GS_CO_STACK_CACHE_SIZE 64
+
+struct gs_co_t
+{
+    ucontext_t context;
+
+    /* Whoever resumed the coroutine last, the loop or another coroutine. */
+    ucontext_t caller;
+
+    struct gs_loop_t *loop;
+    gs_co_routine_t routine;
+    void *user_data;
+
+    /* The mapping, guard page included. */
+    void *stack;
+    size_t stack_size;
+
+    struct gs_timer_t timer;
+    unsigned int events;
+    bool done;
+};
+
+struct gs_co_stack_t
+{
+    struct gs_co_stack_t *next;
+};
+
+static __thread struct gs_co_t *gs_co_current = NULL;
+
+static __thread struct gs_co_stack_t *gs_co_stacks = NULL;
+static __thread unsigned int gs_co_stacks_size = 0;
+
+static size_t gs_co_page_size(void)
+{
+    static size_t page_size = 0;
+
+    if (!page_size) {
+        page_size = (size_t)sysconf(_SC_PAGESIZE);
+    }
+
+    return page_size;
+}
+
+static void * gs_co_stack_alloc(size_t size)
+{
+    if ((size == GS_CO_STACK_SIZE + gs_co_page_size()) && gs_co_stacks) {
+        struct gs_co_stack_t *stack = gs_co_stacks;
+
+        gs_co_stacks = stack->next;
+        --gs_co_stacks_size;
+
+        return (char *)stack - gs_co_page_size();
+    }
+
+    void *stack = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+
+    if (stack == MAP_FAILED) {
+        return NULL;
+    }
+
+    /* Stacks grow down, the lowest page catches overflows. */
+    if (mprotect(stack, gs_co_page_size(), PROT_NONE) < 0) {
+        munmap(stack, size);
+        return NULL;
+    }
+
+    return stack;
+}
+
+static void gs_co_stack_free(void *stack, size_t size)
+{
+    if ((size == GS_CO_STACK_SIZE + gs_co_page_size()) && (gs_co_stacks_size < GS_CO_STACK_CACHE_SIZE)) {
+        /* The link lives in the first usable page, right above the guard. */
+        struct gs_co_stack_t *cached = (struct gs_co_stack_t *)((char *)stack + gs_co_page_size());
+
+        cached->next = gs_co_stacks;
+        gs_co_stacks = cached;
+        ++gs_co_stacks_size;
+
+        return;
+    }
+
+    munmap(stack, size);
+}
+
+static void gs_co_destroy(struct gs_co_t *co)
+{
+    gs_co_stack_free(co->stack, co->stack_size);
+    free(co);
+}
+
+static void gs_co_resume(struct gs_co_t *co)
+{
+    struct gs_co_t *previous = gs_co_current;
+
+    gs_co_current = co;
+    swapcontext(&co->caller, &co->context);
+    gs_co_current = previous;
+
+    /* A finished coroutine cannot release the stack it runs on, its caller does. */
+    if (co->done) {
+        gs_co_destroy(co);
+    }
+}
+
+static void gs_co_yield(struct gs_co_t *co)
+{
+    swapcontext(&co->context, &co->caller);
+}
+
+static void gs_co_main(void)
+{
+    struct gs_co_t *co = gs_co_current;
+
+    co->routine(co->user_data);
+    co->done = true;
+
+    gs_co_yield(co);
+}
+
+int gs_co_spawn(struct gs_loop_t *loop, gs_co_routine_t routine, void *user_data, size_t stack_size)
+{
+    if (!loop || !routine) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    const size_t page_size = gs_co_page_size();
+    const size_t size = (((stack_size ? stack_size : GS_CO_STACK_SIZE) + page_size - 1) & ~(page_size - 1)) + page_size;
+
+    struct gs_co_t *co = (struct gs_co_t *)calloc(1, sizeof(struct gs_co_t));
+
+    if (!co) {
+        return -1;
+    }
+
+    co->stack = gs_co_stack_alloc(size);
+
+    if (!co->stack) {
+        free(co);
+        return -1;
+    }
+
+    co->stack_size = size;
+    co->loop = loop;
+    co->routine = routine;
+    co->user_data = user_data;
+
+    if (getcontext(&co->context) < 0) {
+        gs_co_destroy(co);
+        return -1;
+    }
+
+    co->context.uc_stack.ss_sp = (char *)co->stack + page_size;
+    co->context.uc_stack.ss_size = size - page_size;
+    co->context.uc_link = NULL;
+
+    makecontext(&co->context, gs_co_main, 0);
+
+    gs_co_resume(co);
+
+    return 0;
+}
+
+/* Resumes the coroutine waiting on the socket, events arriving while nobody waits are dropped. */
+static void gs_co_ready(struct gs_loop_t *loop, struct gs_socket_t *gsocket, unsigned int events, void *user_data)
+{
+    (void)loop;
+
+    struct gs_co_t *co = (struct gs_co_t *)user_data;
+
+    if (!co) {
+        return;
+    }
+
+    gsocket->user_data = NULL;
+    co->events = events;
+
+    gs_co_resume(co);
+}
+
+static void gs_co_timer_expired(struct gs_loop_t *loop, struct gs_timer_t *timer, void *user_data)
+{
+    (void)loop;
+    (void)timer;
+
+    gs_co_resume((struct gs_co_t *)user_data);
+}
+
+/**
+ * Registers the socket once, edge-triggered for both directions. A wait
+ * only starts after EAGAIN, so the next edge is exactly what it waits for
+ * and no epoll_ctl() is needed per wait.
+ */
+static int gs_co_attach(struct gs_co_t *co, struct gs_socket_t *gsocket)
+{
+    if (gsocket->loop) {
+        if ((gsocket->loop != co->loop) || (gsocket->handler != gs_co_ready)) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        return 0;
+    }
+
+    return gs_loop_add(co->loop, gsocket, GS_LOOP_EVENT_READABLE | GS_LOOP_EVENT_WRITABLE, gs_co_ready, NULL);
+}
+
+static int gs_co_wait(struct gs_co_t *co, struct gs_socket_t *gsocket)
+{
+    if (gsocket->user_data) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    gsocket->user_data = co;
+    gs_co_yield(co);
+
+    if (co->events == GS_LOOP_EVENT_TIMEOUT) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+
+    return 0;
+}
+
+static inline bool gs_co_again(void)
+{
+    return (errno == EAGAIN) || (errno == EWOULDBLOCK);
+}
+
+int gs_co_recv(struct gs_socket_t *gsocket, void *data, unsigned int length, int flags)
+{
+    struct gs_co_t *co = gs_co_current;
+
+    if (!co) {
+        return gs_recv(gsocket, data, length, flags);
+    }
+
+    if (gs_co_attach(co, gsocket) < 0) {
+        return -1;
+    }
+
+    while (true) {
+        const int bytes = gs_recv(gsocket, data, length, flags | MSG_DONTWAIT);
+
+        if ((bytes >= 0) || !gs_co_again()) {
+            return bytes;
+        }
+
+        if (gs_co_wait(co, gsocket) < 0) {
+            return -1;
+        }
+    }
+}
+
+int gs_co_send(struct gs_socket_t *gsocket, const void *data, unsigned int length, int flags)
+{
+    struct gs_co_t *co = gs_co_current;
+
+    if (!co) {
+        return gs_send(gsocket, data, length, flags);
+    }
+
+    if (gs_co_attach(co, gsocket) < 0) {
+        return -1;
+    }
+
+    unsigned int sent = 0;
+
+    while (sent < length) {
+        const int bytes = gs_send(gsocket, (const char *)data + sent, length - sent, flags | MSG_DONTWAIT | MSG_NOSIGNAL);
+
+        if (bytes >= 0) {
+            sent += (unsigned int)bytes;
+            continue;
+        }
+
+        if (!gs_co_again() || (gs_co_wait(co, gsocket) < 0)) {
+            return sent ? (int)sent : -1;
+        }
+    }
+
+    return (int)sent;
+}
+
+struct gs_socket_t * gs_co_accept(struct gs_socket_t *gsocket, char *address, unsigned int length)
+{
+    struct gs_co_t *co = gs_co_current;
+
+    if (!co) {
+        return gs_accept(gsocket, address, length);
+    }
+
+    if (gs_co_attach(co, gsocket) < 0) {
+        return NULL;
+    }
+
+    while (true) {
+        struct gs_socket_t *client = gs_accept(gsocket, address, length);
+
+        if (client || !gs_co_again()) {
+            return client;
+        }
+
+        if (gs_co_wait(co, gsocket) < 0) {
+            return NULL;
+        }
+    }
+}
+
+int gs_co_connect(struct gs_socket_t *gsocket, const char *address)
+{
+    struct gs_co_t *co = gs_co_current;
+
+    if (!co) {
+        return gs_connect(gsocket, address);
+    }
+
+    if (gs_connect_async(gsocket, address) == 0) {
+        return gs_co_attach(co, gsocket);
+    }
+
+    if ((errno != EINPROGRESS) || (gs_co_attach(co, gsocket) < 0)) {
+        return -1;
+    }
+
+    /* Only the first edge after the handshake matters, spurious ones loop back here. */
+    while (true) {
+        if (gs_co_wait(co, gsocket) < 0) {
+            return -1;
+        }
+
+        if (co->events & (GS_LOOP_EVENT_WRITABLE | GS_LOOP_EVENT_HANGUP | GS_LOOP_EVENT_ERROR)) {
+            return gs_connect_result(gsocket);
+        }
+    }
+}
+
+int gs_co_sleep(unsigned int timeout)
+{
+    struct gs_co_t *co = gs_co_current;
+
+    if (!co) {
+        return usleep((useconds_t)timeout * 1000);
+    }
+
+    gs_timer_init(&co->timer, gs_co_timer_expired, co);
+
+    if (gs_timer_start(co->loop, &co->timer, timeout) < 0) {
+        return -1;
+    }
+
+    gs_co_yield(co);
+
+    return 0;
+}
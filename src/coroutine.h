@@ -0,0 +1,54 @@
+#ifndef GS_COROUTINE_H_
+#define GS_COROUTINE_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct gs_socket_t;
+struct gs_loop_t;
+
+/* Default stack of a coroutine, only the pages it touches are backed by memory. */
+#define GS_CO_STACK_SIZE (64 * 1024)
+
+typedef void (*gs_co_routine_t)(void *user_data);
+
+/**
+ * Runs `routine` as a stackful coroutine scheduled by `loop`. It starts
+ * right away and runs until its first wait, then continues from the loop
+ * thread whenever what it waits for is ready. `stack_size` 0 picks
+ * GS_CO_STACK_SIZE; a guard page below the stack turns an overflow into a
+ * crash instead of memory corruption. The coroutine is freed once
+ * `routine` returns.
+ */
+int gs_co_spawn(struct gs_loop_t *loop, gs_co_routine_t routine, void *user_data, size_t stack_size);
+
+/**
+ * gs_recv(), gs_send(), gs_accept() and gs_connect() that look blocking
+ * but let other coroutines run until the socket is ready. Outside of a
+ * coroutine they are the plain blocking calls.
+ *
+ * The first call registers the socket in the coroutine's loop, and from
+ * then on the socket belongs to this layer: one coroutine waits on it at
+ * a time, and it must not be added to a loop by other means. Deadlines
+ * set with gs_loop_set_timeouts() end a wait with ETIMEDOUT.
+ * gs_co_send() returns once all of `length` is sent or an error occurs.
+ */
+int gs_co_recv(struct gs_socket_t *gsocket, void *data, unsigned int length, int flags);
+
+int gs_co_send(struct gs_socket_t *gsocket, const void *data, unsigned int length, int flags);
+
+struct gs_socket_t * gs_co_accept(struct gs_socket_t *gsocket, char *address, unsigned int length);
+
+int gs_co_connect(struct gs_socket_t *gsocket, const char *address);
+
+/* Suspends the calling coroutine for `timeout` milliseconds, 0 lets the others run first. */
+int gs_co_sleep(unsigned int timeout);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* GS_COROUTINE_H_ */
@@ -9,6 +9,9 @@ typedef enum
 {
     GS_SOCKET_DOMAIN_UNIX = 0,
     GS_SOCKET_DOMAIN_TCP,
+    GS_SOCKET_DOMAIN_UDP,
+    GS_SOCKET_DOMAIN_UNIX_DGRAM,
+    GS_SOCKET_DOMAIN_UNIX_SEQPACKET,
     GS_SOCKET_DOMAIN_AMOUNT
 } GS_SOCKET_DOMAIN_TYPE;
 
@@ -0,0 +1,24 @@
+#ifndef GS_FDS_H_
+#define GS_FDS_H_
+
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Most descriptors a single gs_send_fds()/gs_recv_fds() message carries. */
+#define GS_MAX_FDS 16
+
+struct gs_cred_t
+{
+    pid_t pid;
+    uid_t uid;
+    gid_t gid;
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* GS_FDS_H_ */
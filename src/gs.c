@@ -1,7 +1,14 @@
 #include "gs.h"
 #include "socket.h"
+#include "inet.h"
+#include "unix_socket.h"
 
 #include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <fcntl.h>
 
 struct gs_socket_t * gs_socket(GS_SOCKET_DOMAIN_TYPE domain)
 {
@@ -15,36 +22,448 @@ struct gs_socket_t * gs_socket(GS_SOCKET_DOMAIN_TYPE domain)
     return gsocket;
 }
 
+static bool gs_adopt_check(GS_SOCKET_DOMAIN_TYPE domain, int fd)
+{
+    int family = 0;
+    int type = 0;
+    socklen_t length = sizeof(int);
+
+    if (getsockopt(fd, SOL_SOCKET, SO_DOMAIN, &family, &length) < 0) {
+        return false;
+    }
+
+    length = sizeof(int);
+
+    if (getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &length) < 0) {
+        return false;
+    }
+
+    switch (domain) {
+        case GS_SOCKET_DOMAIN_UNIX:
+            return (family == AF_UNIX) && (type == SOCK_STREAM);
+        case GS_SOCKET_DOMAIN_UNIX_DGRAM:
+            return (family == AF_UNIX) && (type == SOCK_DGRAM);
+        case GS_SOCKET_DOMAIN_UNIX_SEQPACKET:
+            return (family == AF_UNIX) && (type == SOCK_SEQPACKET);
+        case GS_SOCKET_DOMAIN_TCP:
+            return ((family == AF_INET) || (family == AF_INET6)) && (type == SOCK_STREAM);
+        case GS_SOCKET_DOMAIN_UDP:
+            return ((family == AF_INET) || (family == AF_INET6)) && (type == SOCK_DGRAM);
+        default:
+            return false;
+    }
+}
+
+struct gs_socket_t * gs_adopt(GS_SOCKET_DOMAIN_TYPE domain, int fd)
+{
+    if (!gs_adopt_check(domain, fd)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    struct gs_socket_t *gsocket = gs_socket(domain);
+
+    if (!gsocket) {
+        return NULL;
+    }
+
+    gsocket->fd = fd;
+
+    if (fcntl(fd, F_GETFL) & O_NONBLOCK) {
+        gsocket->flags |= GS_SOCKET_FLAG_NONBLOCK;
+    }
+
+    return gsocket;
+}
+
+/* A TCP socket cannot use a UNIX address and vice versa, UDP shares the TCP format. */
+static int gs_addr_check(const struct gs_socket_t *gsocket, const struct gs_addr_t *address)
+{
+    const bool inet = (gsocket->domain == GS_SOCKET_DOMAIN_TCP) || (gsocket->domain == GS_SOCKET_DOMAIN_UDP);
+    const bool inet_address = (address->storage.ss_family == AF_INET) || (address->storage.ss_family == AF_INET6);
+
+    if (inet != inet_address) {
+        errno = EAFNOSUPPORT;
+        return -1;
+    }
+
+    return 0;
+}
+
 int gs_bind(struct gs_socket_t *gsocket, const char *address, int backlog)
 {
+    struct gs_addr_t parsed;
+
+    if (gs_addr_parse(&parsed, gsocket->domain, address) < 0) {
+        return -1;
+    }
+
+    return gsocket->base->bind(gsocket, &parsed, backlog);
+}
+
+int gs_bind_addr(struct gs_socket_t *gsocket, const struct gs_addr_t *address, int backlog)
+{
+    if (gs_addr_check(gsocket, address) < 0) {
+        return -1;
+    }
+
     return gsocket->base->bind(gsocket, address, backlog);
 }
 
 struct gs_socket_t * gs_accept(struct gs_socket_t *gsocket, char *address, unsigned int length)
 {
+    if (!gsocket->base->accept) {
+        errno = EOPNOTSUPP;
+        return NULL;
+    }
+
     struct gs_socket_t *client = gs_socket_create(gsocket->domain);
 
-    if (gsocket->base->accept(gsocket, address, length, client) < 0) {
+    const unsigned long long start = GS_STATS_CLOCK();
+    const int accepted = gsocket->base->accept(gsocket, address, length, client);
+
+    GS_STATS_RECORD(gsocket, GS_STATS_OP_ACCEPT, (accepted < 0) ? -1 : 1, 0, start);
+
+    if (accepted < 0) {
         gs_socket_destroy(client);
         return NULL;
     }
 
+    if (gs_socket_inherit_opts(client, gsocket) < 0) {
+        gs_close(client);
+        return NULL;
+    }
+
     return client;
 }
 
+int gs_accept_batch(struct gs_socket_t *gsocket, struct gs_socket_t **clients, struct gs_peer_t *peers, unsigned int max, int flags)
+{
+    if (!gsocket->base->accept4) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    const int socket_flags = ((flags & GS_ACCEPT_NONBLOCK) ? SOCK_NONBLOCK : 0) | ((flags & GS_ACCEPT_CLOEXEC) ? SOCK_CLOEXEC : 0);
+    const unsigned long long start = GS_STATS_CLOCK();
+    unsigned int count = 0;
+
+    while (count < max) {
+        struct gs_socket_t *client = gs_socket_create(gsocket->domain);
+
+        if (!client) {
+            break;
+        }
+
+        client->base->init(client);
+
+        struct sockaddr *address = NULL;
+        socklen_t *length = NULL;
+
+        if (peers) {
+            peers[count].length = sizeof(peers[count].address);
+            address = (struct sockaddr *)&peers[count].address;
+            length = &peers[count].length;
+        }
+
+        if (gsocket->base->accept4(gsocket, address, length, socket_flags, client) < 0) {
+            gs_socket_destroy(client);
+
+            /* A client that reset while queued only costs its own slot, the rest of the backlog is still there. */
+            if ((errno == ECONNABORTED) || (errno == EPROTO) || (errno == EINTR)) {
+                continue;
+            }
+
+            break;
+        }
+
+        if (gs_socket_inherit_opts(client, gsocket) < 0) {
+            gs_close(client);
+            continue;
+        }
+
+        clients[count++] = client;
+    }
+
+    GS_STATS_RECORD(gsocket, GS_STATS_OP_ACCEPT, count ? (long)count : -1, 0, start);
+
+    return count ? (int)count : -1;
+}
+
 int gs_connect(struct gs_socket_t *gsocket, const char *address)
 {
-    return gsocket->base->connect(gsocket, address);
+    struct gs_addr_t parsed;
+
+    if (gs_addr_parse(&parsed, gsocket->domain, address) < 0) {
+        return -1;
+    }
+
+    const int result = gsocket->base->connect(gsocket, &parsed);
+
+    GS_STATS_RECORD(gsocket, GS_STATS_OP_CONNECT, result, 0, 0ULL);
+
+    return result;
+}
+
+int gs_connect_async(struct gs_socket_t *gsocket, const char *address)
+{
+    gsocket->flags |= GS_SOCKET_FLAG_NONBLOCK;
+
+    return gs_connect(gsocket, address);
+}
+
+int gs_connect_addr(struct gs_socket_t *gsocket, const struct gs_addr_t *address)
+{
+    if (gs_addr_check(gsocket, address) < 0) {
+        return -1;
+    }
+
+    const int result = gsocket->base->connect(gsocket, address);
+
+    GS_STATS_RECORD(gsocket, GS_STATS_OP_CONNECT, result, 0, 0ULL);
+
+    return result;
+}
+
+int gs_connect_addr_async(struct gs_socket_t *gsocket, const struct gs_addr_t *address)
+{
+    gsocket->flags |= GS_SOCKET_FLAG_NONBLOCK;
+
+    return gs_connect_addr(gsocket, address);
+}
+
+int gs_connect_wait(struct gs_socket_t *gsocket, int timeout)
+{
+    struct pollfd pollfd;
+    memset(&pollfd, 0, sizeof(struct pollfd));
+    pollfd.fd = gsocket->fd;
+    pollfd.events = POLLOUT;
+
+    int result = 0;
+
+    do {
+        result = poll(&pollfd, 1, timeout);
+    } while ((result < 0) && (errno == EINTR));
+
+    if (result < 0) {
+        return -1;
+    }
+
+    if (result == 0) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+
+    return gs_connect_result(gsocket);
+}
+
+int gs_connect_result(struct gs_socket_t *gsocket)
+{
+    int error = 0;
+    socklen_t length = sizeof(error);
+
+    if (getsockopt(gsocket->fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0) {
+        return -1;
+    }
+
+    if (error) {
+        errno = error;
+        return -1;
+    }
+
+    return 0;
+}
+
+#ifdef GS_STATS
+
+static size_t gs_mmsg_length(const struct mmsghdr *messages, int count)
+{
+    size_t length = 0;
+
+    for (int index = 0; index < count; ++index) {
+        length += messages[index].msg_len;
+    }
+
+    return length;
 }
 
+#endif
+
 int gs_send(struct gs_socket_t *gsocket, const void *data, unsigned int length, int flags)
 {
-    return gsocket->base->send(gsocket, data, length, flags);
+    const unsigned long long start = GS_STATS_CLOCK();
+    const int bytes = gsocket->base->send(gsocket, data, length, flags);
+
+    GS_STATS_RECORD(gsocket, GS_STATS_OP_SEND, bytes, length, start);
+
+    return bytes;
 }
 
 int gs_recv(struct gs_socket_t *gsocket, void *data, unsigned int length, int flags)
 {
-    return gsocket->base->recv(gsocket, data, length, flags);
+    const unsigned long long start = GS_STATS_CLOCK();
+    const int bytes = gsocket->base->recv(gsocket, data, length, flags);
+
+    GS_STATS_RECORD(gsocket, GS_STATS_OP_RECV, bytes, length, start);
+
+    return bytes;
+}
+
+int gs_sendv(struct gs_socket_t *gsocket, const struct iovec *iov, unsigned int count, int flags)
+{
+    const unsigned long long start = GS_STATS_CLOCK();
+    const int bytes = gsocket->base->sendv(gsocket, iov, count, flags);
+
+    GS_STATS_RECORD(gsocket, GS_STATS_OP_SEND, bytes, gs_iov_length(iov, count), start);
+
+    return bytes;
+}
+
+int gs_recvv(struct gs_socket_t *gsocket, const struct iovec *iov, unsigned int count, int flags)
+{
+    const unsigned long long start = GS_STATS_CLOCK();
+    const int bytes = gsocket->base->recvv(gsocket, iov, count, flags);
+
+    GS_STATS_RECORD(gsocket, GS_STATS_OP_RECV, bytes, 0, start);
+
+    return bytes;
+}
+
+int gs_send_batch(struct gs_socket_t *gsocket, struct mmsghdr *messages, unsigned int count, int flags)
+{
+    const unsigned long long start = GS_STATS_CLOCK();
+    const int result = gsocket->base->send_batch(gsocket, messages, count, flags);
+
+    /* Counted in bytes like the other calls, a short batch is not a partial send. */
+    GS_STATS_RECORD(gsocket, GS_STATS_OP_SEND, (result < 0) ? -1 : (long)gs_mmsg_length(messages, result), 0, start);
+
+    return result;
+}
+
+int gs_recv_batch(struct gs_socket_t *gsocket, struct mmsghdr *messages, unsigned int count, int flags)
+{
+    const unsigned long long start = GS_STATS_CLOCK();
+    const int result = gsocket->base->recv_batch(gsocket, messages, count, flags);
+
+    /* Counted in bytes like the other receives. */
+    GS_STATS_RECORD(gsocket, GS_STATS_OP_RECV, (result < 0) ? -1 : (long)gs_mmsg_length(messages, result), 0, start);
+
+    return result;
+}
+
+int gs_sendfile(struct gs_socket_t *gsocket, int file_fd, off_t *offset, size_t count)
+{
+    if (!gsocket->base->sendfile) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    const unsigned long long start = GS_STATS_CLOCK();
+    const int bytes = gsocket->base->sendfile(gsocket, file_fd, offset, count);
+
+    GS_STATS_RECORD(gsocket, GS_STATS_OP_SEND, bytes, count, start);
+
+    return bytes;
+}
+
+/* Descriptor passing, credentials and autobind are AF_UNIX features, whichever socket type. */
+static inline bool gs_is_unix(const struct gs_socket_t *gsocket)
+{
+    return (gsocket->domain == GS_SOCKET_DOMAIN_UNIX) || (gsocket->domain == GS_SOCKET_DOMAIN_UNIX_DGRAM) ||
+        (gsocket->domain == GS_SOCKET_DOMAIN_UNIX_SEQPACKET);
+}
+
+int gs_send_fds(struct gs_socket_t *gsocket, const void *data, unsigned int length, const int *fds, unsigned int count, int flags)
+{
+    if (!gs_is_unix(gsocket)) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    const unsigned long long start = GS_STATS_CLOCK();
+    const int bytes = gsocket->base->send_fds(gsocket, data, length, fds, count, flags);
+
+    GS_STATS_RECORD(gsocket, GS_STATS_OP_SEND, bytes, length, start);
+
+    return bytes;
+}
+
+int gs_recv_fds(struct gs_socket_t *gsocket, void *data, unsigned int length, int *fds, unsigned int *count, struct gs_cred_t *cred, int flags)
+{
+    if (!gs_is_unix(gsocket)) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    const unsigned long long start = GS_STATS_CLOCK();
+    const int bytes = gsocket->base->recv_fds(gsocket, data, length, fds, count, cred, flags);
+
+    GS_STATS_RECORD(gsocket, GS_STATS_OP_RECV, bytes, length, start);
+
+    return bytes;
+}
+
+int gs_passcred(struct gs_socket_t *gsocket, bool enable)
+{
+    if (!gs_is_unix(gsocket)) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    const int value = enable ? 1 : 0;
+
+    return setsockopt(gsocket->fd, SOL_SOCKET, SO_PASSCRED, &value, sizeof(value));
+}
+
+int gs_autobind(struct gs_socket_t *gsocket)
+{
+    if (!gs_is_unix(gsocket)) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    gsocket->flags |= GS_SOCKET_FLAG_AUTOBIND;
+
+    return (gsocket->fd >= 0) ? gs_unix_autobind(gsocket->fd) : 0;
+}
+
+int gs_local_address(struct gs_socket_t *gsocket, char *address, unsigned int length)
+{
+    struct sockaddr_storage storage;
+    socklen_t storage_length = sizeof(struct sockaddr_storage);
+
+    memset(&storage, 0, sizeof(struct sockaddr_storage));
+
+    if (getsockname(gsocket->fd, (struct sockaddr *)&storage, &storage_length) < 0) {
+        return -1;
+    }
+
+    if (storage.ss_family == AF_UNIX) {
+        return gs_unix_format((const struct sockaddr *)&storage, storage_length, address, length);
+    }
+
+    return gs_inet_format((const struct sockaddr *)&storage, address, length);
+}
+
+int gs_peer_cred(struct gs_socket_t *gsocket, struct gs_cred_t *cred)
+{
+    if (!gs_is_unix(gsocket)) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    struct ucred peer;
+    socklen_t length = sizeof(struct ucred);
+
+    if (getsockopt(gsocket->fd, SOL_SOCKET, SO_PEERCRED, &peer, &length) < 0) {
+        return -1;
+    }
+
+    cred->pid = peer.pid;
+    cred->uid = peer.uid;
+    cred->gid = peer.gid;
+
+    return 0;
 }
 
 int gs_raw_fd(struct gs_socket_t *gsocket)
@@ -54,8 +473,18 @@ int gs_raw_fd(struct gs_socket_t *gsocket)
 
 int gs_close(struct gs_socket_t *gsocket)
 {
+    if (gsocket->loop) {
+        gs_loop_remove(gsocket->loop, gsocket);
+    }
+
     gsocket->base->close(gsocket);
 
+    gs_msg_buffer_destroy(gsocket->rx);
+
+    gs_write_queue_destroy(gsocket->wq);
+
+    gs_splice_pipe_destroy(gsocket->pipe);
+
     gs_socket_destroy(gsocket);
 
     return 0;
@@ -1,7 +1,29 @@
 #ifndef GS_H_
 #define GS_H_
 
+#include <stdbool.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/types.h>
+
 #include "domain.h"
+#include "fds.h"
+#include "address.h"
+#include "loop.h"
+#include "coroutine.h"
+#include "server.h"
+#include "worker.h"
+#include "socket_pool.h"
+#include "pool.h"
+#include "buffer_pool.h"
+#include "shm.h"
+#include "handoff.h"
+#include "message.h"
+#include "options.h"
+#include "stats.h"
+#include "write_queue.h"
+#include "zerocopy.h"
+#include "uring.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -9,16 +31,125 @@ extern "C" {
 
 struct gs_socket_t * gs_socket(GS_SOCKET_DOMAIN_TYPE domain);
 
+/**
+ * Wraps an open socket descriptor, e.g. one received with gs_recv_fds(),
+ * and takes ownership of it on success. Fails with EINVAL if the
+ * descriptor's family or type does not match `domain`.
+ */
+struct gs_socket_t * gs_adopt(GS_SOCKET_DOMAIN_TYPE domain, int fd);
+
 int gs_bind(struct gs_socket_t *gsocket, const char *address, int backlog);
 
+/* Binds a pre-resolved address. An IPv6 wildcard such as "[::]:port" also accepts IPv4 clients. */
+int gs_bind_addr(struct gs_socket_t *gsocket, const struct gs_addr_t *address, int backlog);
+
 struct gs_socket_t * gs_accept(struct gs_socket_t *gsocket, char *address, unsigned int length);
 
+enum
+{
+    GS_ACCEPT_NONBLOCK = 0x01,
+    GS_ACCEPT_CLOEXEC = 0x02
+};
+
+struct gs_peer_t
+{
+    struct sockaddr_storage address;
+    socklen_t length;
+};
+
+/**
+ * Accepts up to `max` pending clients in one call, stopping early once the
+ * backlog is drained. `peers` is optional and receives the raw addresses.
+ * Clients that reset before they were accepted are skipped. Returns the
+ * number of clients, or -1 if none could be accepted: errno is EAGAIN once
+ * the backlog is empty, EMFILE/ENFILE/ENOBUFS/ENOMEM when out of resources
+ * with clients still queued.
+ */
+int gs_accept_batch(struct gs_socket_t *gsocket, struct gs_socket_t **clients, struct gs_peer_t *peers, unsigned int max, int flags);
+
 int gs_connect(struct gs_socket_t *gsocket, const char *address);
 
+/**
+ * Starts a non-blocking connect. Returns 0 if connected right away, or -1
+ * with errno EINPROGRESS while the handshake is pending; completion is
+ * reported by gs_connect_wait(), or by a writable event when the socket is
+ * added to a loop (see gs_loop_connect()).
+ */
+int gs_connect_async(struct gs_socket_t *gsocket, const char *address);
+
+/* gs_connect() and gs_connect_async() on a pre-resolved address, nothing is parsed. */
+int gs_connect_addr(struct gs_socket_t *gsocket, const struct gs_addr_t *address);
+
+int gs_connect_addr_async(struct gs_socket_t *gsocket, const struct gs_addr_t *address);
+
+/* Waits up to timeout milliseconds (-1 for infinite), fails with ETIMEDOUT or the connect error. */
+int gs_connect_wait(struct gs_socket_t *gsocket, int timeout);
+
+/* Returns 0 once a pending connect succeeded, otherwise -1 with errno set to the connect error. */
+int gs_connect_result(struct gs_socket_t *gsocket);
+
 int gs_send(struct gs_socket_t *gsocket, const void *data, unsigned int length, int flags);
 
 int gs_recv(struct gs_socket_t *gsocket, void *data, unsigned int length, int flags);
 
+/* Vectored variants of gs_send()/gs_recv(), the iovecs are passed straight to sendmsg()/recvmsg(). */
+int gs_sendv(struct gs_socket_t *gsocket, const struct iovec *iov, unsigned int count, int flags);
+
+int gs_recvv(struct gs_socket_t *gsocket, const struct iovec *iov, unsigned int count, int flags);
+
+/**
+ * Moves up to `count` messages with a single sendmmsg()/recvmmsg(). Set
+ * msg_hdr.msg_name to address datagrams, msg_len holds the bytes
+ * transferred. Returns the number of messages processed.
+ */
+int gs_send_batch(struct gs_socket_t *gsocket, struct mmsghdr *messages, unsigned int count, int flags);
+
+int gs_recv_batch(struct gs_socket_t *gsocket, struct mmsghdr *messages, unsigned int count, int flags);
+
+/* Sends `count` bytes of a file with sendfile(), `offset` is updated when not NULL. */
+int gs_sendfile(struct gs_socket_t *gsocket, int file_fd, off_t *offset, size_t count);
+
+/**
+ * Forwards up to `count` bytes from one socket to another through a pipe
+ * owned by the destination, without copying them to user space. Returns
+ * the bytes taken from `from`; bytes the destination could not accept yet
+ * stay in the pipe and are sent first on the next call.
+ */
+long gs_splice(struct gs_socket_t *from, struct gs_socket_t *to, size_t count);
+
+/**
+ * Sends `length` bytes together with `count` open descriptors (SCM_RIGHTS)
+ * over a UNIX-domain socket, the data has to be at least one byte. The
+ * receiver gets duplicates, the caller may close its own right after.
+ * Fails with EOPNOTSUPP on other domains and on shared-memory connections.
+ */
+int gs_send_fds(struct gs_socket_t *gsocket, const void *data, unsigned int length, const int *fds, unsigned int count, int flags);
+
+/**
+ * Receives data and the descriptors that came with it, opened close-on-exec.
+ * `count` holds the room in `fds` and is updated with the number received,
+ * descriptors that do not fit are closed. `cred` is optional and receives
+ * the sender's credentials once gs_passcred() is enabled, pid 0 otherwise.
+ */
+int gs_recv_fds(struct gs_socket_t *gsocket, void *data, unsigned int length, int *fds, unsigned int *count, struct gs_cred_t *cred, int flags);
+
+/* Sets SO_PASSCRED, so that the kernel attaches the sender's credentials to every message. */
+int gs_passcred(struct gs_socket_t *gsocket, bool enable);
+
+/**
+ * Gives a UNIX-domain socket a unique abstract name chosen by the kernel:
+ * right away if it is open, otherwise when gs_connect() opens it. Lets an
+ * anonymous client be told apart by the server, and lets a datagram
+ * client receive replies, without managing paths.
+ */
+int gs_autobind(struct gs_socket_t *gsocket);
+
+/* Formats the locally bound address the way gs_bind() takes it, e.g. "@0001f" after gs_autobind(). */
+int gs_local_address(struct gs_socket_t *gsocket, char *address, unsigned int length);
+
+/* The credentials the connected peer had when the connection was made (SO_PEERCRED). */
+int gs_peer_cred(struct gs_socket_t *gsocket, struct gs_cred_t *cred);
+
 int gs_raw_fd(struct gs_socket_t *gsocket);
 
 int gs_close(struct gs_socket_t *gsocket);
@@ -0,0 +1,318 @@
+#include "handoff.h"
+#include "gs.h"
+#include "socket.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+
+/* "gshf", tells a handoff message from anything else sent to the control path. */
+#define GS_HANDOFF_MAGIC 0x67736866U
+
+struct gs_handoff_record_t
+{
+    uint32_t domain;
+    char address[GS_SOCKET_ADDRESS_SIZE];
+};
+
+/* One SOCK_SEQPACKET message carries every listener, its descriptors ride along in the same order. */
+struct gs_handoff_message_t
+{
+    uint32_t magic;
+    uint32_t count;
+    struct gs_handoff_record_t records[GS_MAX_FDS];
+};
+
+static int gs_handoff_wait(struct gs_socket_t *gsocket, int timeout)
+{
+    struct pollfd pollfd;
+    memset(&pollfd, 0, sizeof(struct pollfd));
+    pollfd.fd = gsocket->fd;
+    pollfd.events = POLLIN;
+
+    int result = 0;
+
+    do {
+        result = poll(&pollfd, 1, timeout);
+    } while ((result < 0) && (errno == EINTR));
+
+    if (result < 0) {
+        return -1;
+    }
+
+    if (result == 0) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Binds next to `path` and renames over it, so the path is never missing for a connecting successor. */
+static int gs_handoff_replace(struct gs_socket_t *control, const char *path)
+{
+    char temporary[GS_SOCKET_ADDRESS_SIZE];
+
+    if (snprintf(temporary, sizeof(temporary), "%s.%d", path, (int)getpid()) >= (int)sizeof(temporary)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    unlink(temporary);
+
+    if (gs_bind(control, temporary, 1) < 0) {
+        return -1;
+    }
+
+    if (rename(temporary, path) < 0) {
+        return -1;
+    }
+
+    return gs_socket_set_address(control, path);
+}
+
+struct gs_socket_t * gs_handoff_listen(const char *path)
+{
+    struct gs_socket_t *control = gs_socket(GS_SOCKET_DOMAIN_UNIX_SEQPACKET);
+
+    if (!control) {
+        return NULL;
+    }
+
+    int result = gs_bind(control, path, 1);
+
+    /* The predecessor still serves the path, or crashed and left it behind; abstract names cannot be taken over. */
+    if ((result < 0) && (errno == EADDRINUSE) && (path[0] != '@')) {
+        result = gs_handoff_replace(control, path);
+    }
+
+    if (result < 0) {
+        const int error = errno;
+
+        gs_close(control);
+        errno = error;
+
+        return NULL;
+    }
+
+    return control;
+}
+
+static int gs_handoff_send(struct gs_socket_t *successor, struct gs_socket_t **listeners, unsigned int count, int timeout)
+{
+    struct gs_cred_t cred;
+
+    if (gs_peer_cred(successor, &cred) < 0) {
+        return -1;
+    }
+
+    /* Listening sockets are only handed to the same user, root may hand them to anyone. */
+    if ((cred.uid != geteuid()) && (geteuid() != 0)) {
+        errno = EPERM;
+        return -1;
+    }
+
+    struct gs_handoff_message_t message;
+    int fds[GS_MAX_FDS];
+
+    memset(&message, 0, sizeof(struct gs_handoff_message_t));
+    message.magic = GS_HANDOFF_MAGIC;
+    message.count = count;
+
+    for (unsigned int index = 0; index < count; ++index) {
+        message.records[index].domain = (uint32_t)listeners[index]->domain;
+        memcpy(message.records[index].address, listeners[index]->address, GS_SOCKET_ADDRESS_SIZE);
+        fds[index] = listeners[index]->fd;
+    }
+
+    const unsigned int length = (unsigned int)(offsetof(struct gs_handoff_message_t, records) + count * sizeof(struct gs_handoff_record_t));
+
+    if (gs_send_fds(successor, &message, length, fds, count, MSG_NOSIGNAL) < 0) {
+        return -1;
+    }
+
+    uint32_t ack = 0;
+
+    if (gs_handoff_wait(successor, timeout) < 0) {
+        return -1;
+    }
+
+    const int bytes = gs_recv(successor, &ack, sizeof(ack), MSG_DONTWAIT);
+
+    if (bytes < 0) {
+        return -1;
+    }
+
+    /* Closed without confirming, the successor gave up and the listeners stay ours. */
+    if ((bytes != (int)sizeof(ack)) || (ack != GS_HANDOFF_MAGIC)) {
+        errno = ECONNABORTED;
+        return -1;
+    }
+
+    return 0;
+}
+
+int gs_handoff_serve(struct gs_socket_t *control, struct gs_socket_t **listeners, unsigned int count, int timeout)
+{
+    if (!control || !listeners || !count || (count > GS_MAX_FDS)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (unsigned int index = 0; index < count; ++index) {
+        if (!listeners[index] || (listeners[index]->fd < 0)) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    struct gs_socket_t *successor = gs_accept(control, NULL, 0);
+
+    if (!successor) {
+        return -1;
+    }
+
+    const int result = gs_handoff_send(successor, listeners, count, timeout);
+    const int error = errno;
+
+    gs_close(successor);
+
+    if (result < 0) {
+        errno = error;
+        return -1;
+    }
+
+    for (unsigned int index = 0; index < count; ++index) {
+        listeners[index]->flags |= GS_SOCKET_FLAG_HANDOFF;
+    }
+
+    /* The successor binds its own control socket over the path, closing ours must not remove it. */
+    control->flags |= GS_SOCKET_FLAG_HANDOFF;
+
+    return 0;
+}
+
+/* Adopts every received descriptor, on failure none is kept. */
+static int gs_handoff_adopt(const struct gs_handoff_message_t *message, const int *fds, struct gs_socket_t **listeners)
+{
+    for (unsigned int index = 0; index < message->count; ++index) {
+        const struct gs_handoff_record_t *record = &message->records[index];
+
+        listeners[index] = gs_adopt((GS_SOCKET_DOMAIN_TYPE)record->domain, fds[index]);
+
+        if (!listeners[index]) {
+            const int error = errno;
+
+            for (unsigned int adopted = 0; adopted < index; ++adopted) {
+                /* Not ours to unlink yet, the predecessor still serves the path. */
+                listeners[adopted]->flags |= GS_SOCKET_FLAG_HANDOFF;
+                gs_close(listeners[adopted]);
+                listeners[adopted] = NULL;
+            }
+
+            for (unsigned int rest = index; rest < message->count; ++rest) {
+                close(fds[rest]);
+            }
+
+            errno = error;
+            return -1;
+        }
+
+        char address[GS_SOCKET_ADDRESS_SIZE];
+
+        memcpy(address, record->address, GS_SOCKET_ADDRESS_SIZE);
+        address[GS_SOCKET_ADDRESS_SIZE - 1] = '\0';
+
+        gs_socket_set_address(listeners[index], address);
+    }
+
+    return 0;
+}
+
+static int gs_handoff_take(struct gs_socket_t *predecessor, struct gs_socket_t **listeners, unsigned int *count, int timeout)
+{
+    struct gs_handoff_message_t message;
+    int fds[GS_MAX_FDS];
+    unsigned int received = GS_MAX_FDS;
+
+    if (gs_handoff_wait(predecessor, timeout) < 0) {
+        return -1;
+    }
+
+    memset(&message, 0, sizeof(struct gs_handoff_message_t));
+
+    const int bytes = gs_recv_fds(predecessor, &message, sizeof(message), fds, &received, NULL, MSG_DONTWAIT);
+
+    if (bytes < 0) {
+        return -1;
+    }
+
+    const bool valid = (bytes >= (int)offsetof(struct gs_handoff_message_t, records))
+        && (message.magic == GS_HANDOFF_MAGIC)
+        && (message.count == received)
+        && (bytes == (int)(offsetof(struct gs_handoff_message_t, records) + received * sizeof(struct gs_handoff_record_t)));
+
+    if (!valid || (received > *count)) {
+        for (unsigned int index = 0; index < received; ++index) {
+            close(fds[index]);
+        }
+
+        errno = valid ? EMSGSIZE : EPROTO;
+        return -1;
+    }
+
+    if (gs_handoff_adopt(&message, fds, listeners) < 0) {
+        return -1;
+    }
+
+    const uint32_t ack = GS_HANDOFF_MAGIC;
+
+    if (gs_send(predecessor, &ack, sizeof(ack), MSG_NOSIGNAL) != (int)sizeof(ack)) {
+        const int error = errno;
+
+        for (unsigned int index = 0; index < received; ++index) {
+            listeners[index]->flags |= GS_SOCKET_FLAG_HANDOFF;
+            gs_close(listeners[index]);
+            listeners[index] = NULL;
+        }
+
+        errno = error;
+        return -1;
+    }
+
+    *count = received;
+
+    return 0;
+}
+
+int gs_handoff_receive(const char *path, struct gs_socket_t **listeners, unsigned int *count, int timeout)
+{
+    if (!path || !listeners || !count) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    struct gs_socket_t *predecessor = gs_socket(GS_SOCKET_DOMAIN_UNIX_SEQPACKET);
+
+    if (!predecessor) {
+        return -1;
+    }
+
+    int result = gs_connect(predecessor, path);
+
+    if (result == 0) {
+        result = gs_handoff_take(predecessor, listeners, count, timeout);
+    }
+
+    const int error = errno;
+
+    gs_close(predecessor);
+    errno = error;
+
+    return result;
+}
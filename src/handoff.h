@@ -0,0 +1,57 @@
+#ifndef GS_HANDOFF_H_
+#define GS_HANDOFF_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct gs_socket_t;
+
+/**
+ * Hot restart: a running process passes its listening sockets to its
+ * successor over a UNIX control socket, so the kernel accept queues are
+ * never closed and no connection attempt is refused in between.
+ *
+ *   old: control = gs_handoff_listen(path), add it to the loop
+ *   new: gs_handoff_receive(path, listeners, &count, timeout), then accept
+ *        and gs_handoff_listen(path) for the next restart
+ *   old: gs_handoff_serve(control, ...) once control is readable, then
+ *        gs_close() control and the listeners and gs_loop_drain() the
+ *        connections
+ *
+ * The old process keeps accepting until the successor confirmed, and
+ * clients arriving after that wait in the shared backlog. A served control
+ * socket is flagged handed off like the listeners, so the old process may
+ * close it before or after the successor listens on the path.
+ */
+
+/**
+ * Binds the control socket. A path left by a predecessor or a crashed
+ * process is replaced atomically; an abstract "@name" still in use fails
+ * with EADDRINUSE.
+ */
+struct gs_socket_t * gs_handoff_listen(const char *path);
+
+/**
+ * Accepts the successor waiting on `control` and passes it `count`
+ * listeners (at most GS_MAX_FDS) with their domain and address. Returns 0
+ * once the successor confirmed it took them; from then on the listeners
+ * are flagged handed off and closing them leaves a UNIX path in place.
+ * Fails with ETIMEDOUT if no confirmation arrives within timeout
+ * milliseconds (-1 for none), and with EPERM if the successor runs as
+ * another user.
+ */
+int gs_handoff_serve(struct gs_socket_t *control, struct gs_socket_t **listeners, unsigned int count, int timeout);
+
+/**
+ * Connects to the predecessor listening on `path` and adopts its
+ * listeners. `count` holds the room in `listeners` and is updated with
+ * the number received, in the order they were served.
+ */
+int gs_handoff_receive(const char *path, struct gs_socket_t **listeners, unsigned int *count, int timeout);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* GS_HANDOFF_H_ */
@@ -0,0 +1,306 @@
+#include "inet.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+static inline int gs_inet_hex(char c)
+{
+    if ((c >= '0') && (c <= '9')) {
+        return c - '0';
+    }
+
+    if ((c >= 'a') && (c <= 'f')) {
+        return c - 'a' + 10;
+    }
+
+    if ((c >= 'A') && (c <= 'F')) {
+        return c - 'A' + 10;
+    }
+
+    return -1;
+}
+
+/* Reads a decimal number of at most `digits` digits spanning exactly [begin, end). */
+static int gs_inet_decimal(const char *begin, const char *end, unsigned int digits, unsigned long *value)
+{
+    if ((begin == end) || ((unsigned int)(end - begin) > digits)) {
+        return -1;
+    }
+
+    unsigned long result = 0;
+
+    for (const char *cursor = begin; cursor < end; ++cursor) {
+        if ((*cursor < '0') || (*cursor > '9')) {
+            return -1;
+        }
+
+        result = result * 10 + (unsigned long)(*cursor - '0');
+    }
+
+    *value = result;
+
+    return 0;
+}
+
+static int gs_inet_parse_ipv4(const char *begin, const char *end, unsigned char *bytes)
+{
+    for (unsigned int index = 0; index < 4; ++index) {
+        const char *dot = begin;
+
+        while ((dot < end) && (*dot != '.')) {
+            ++dot;
+        }
+
+        if ((index < 3) == (dot == end)) {
+            return -1;
+        }
+
+        unsigned long octet = 0;
+
+        if ((gs_inet_decimal(begin, dot, 3, &octet) < 0) || (octet > 255)) {
+            return -1;
+        }
+
+        bytes[index] = (unsigned char)octet;
+        begin = dot + 1;
+    }
+
+    return 0;
+}
+
+static int gs_inet_parse_ipv6(const char *begin, const char *end, unsigned char *bytes)
+{
+    uint16_t words[8];
+    unsigned int count = 0;
+    int gap = -1;
+
+    const char *cursor = begin;
+
+    if ((cursor < end) && (*cursor == ':')) {
+        if ((cursor + 1 == end) || (cursor[1] != ':')) {
+            return -1;
+        }
+
+        gap = 0;
+        cursor += 2;
+    }
+
+    while (cursor < end) {
+        const char *group_end = cursor;
+
+        while ((group_end < end) && (*group_end != ':') && (*group_end != '.')) {
+            ++group_end;
+        }
+
+        /* A trailing dotted quad fills the last two groups. */
+        if ((group_end < end) && (*group_end == '.')) {
+            if (count > 6) {
+                return -1;
+            }
+
+            unsigned char ipv4[4];
+
+            if (gs_inet_parse_ipv4(cursor, end, ipv4) < 0) {
+                return -1;
+            }
+
+            words[count++] = (uint16_t)((ipv4[0] << 8) | ipv4[1]);
+            words[count++] = (uint16_t)((ipv4[2] << 8) | ipv4[3]);
+            break;
+        }
+
+        if ((count == 8) || (group_end == cursor) || (group_end - cursor > 4)) {
+            return -1;
+        }
+
+        unsigned int word = 0;
+
+        for (; cursor < group_end; ++cursor) {
+            const int digit = gs_inet_hex(*cursor);
+
+            if (digit < 0) {
+                return -1;
+            }
+
+            word = (word << 4) | (unsigned int)digit;
+        }
+
+        words[count++] = (uint16_t)word;
+
+        if (cursor == end) {
+            break;
+        }
+
+        /* A single ':' must be followed by another group. */
+        if (++cursor == end) {
+            return -1;
+        }
+
+        if (*cursor == ':') {
+            if (gap >= 0) {
+                return -1;
+            }
+
+            gap = (int)count;
+            ++cursor;
+        }
+    }
+
+    if (((gap < 0) && (count != 8)) || ((gap >= 0) && (count > 7))) {
+        return -1;
+    }
+
+    memset(bytes, 0, 16);
+
+    const unsigned int head = (gap < 0) ? count : (unsigned int)gap;
+    const unsigned int tail = count - head;
+
+    for (unsigned int index = 0; index < count; ++index) {
+        const unsigned int position = (index < head) ? index : (8 - tail + (index - head));
+
+        bytes[position * 2] = (unsigned char)(words[index] >> 8);
+        bytes[position * 2 + 1] = (unsigned char)(words[index] & 0xff);
+    }
+
+    return 0;
+}
+
+static int gs_inet_parse_scope(const char *begin, const char *end, uint32_t *scope)
+{
+    unsigned long index = 0;
+
+    if (gs_inet_decimal(begin, end, 10, &index) == 0) {
+        *scope = (uint32_t)index;
+        return 0;
+    }
+
+    char name[IF_NAMESIZE];
+
+    if ((begin == end) || ((size_t)(end - begin) >= sizeof(name))) {
+        return -1;
+    }
+
+    memcpy(name, begin, end - begin);
+    name[end - begin] = '\0';
+
+    *scope = if_nametoindex(name);
+
+    return *scope ? 0 : -1;
+}
+
+int gs_inet_parse(const char *address, struct sockaddr_storage *storage, socklen_t *length)
+{
+    if (!address || !storage || !length) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    const char *end = address + strlen(address);
+    const char *colon = end;
+
+    while ((colon > address) && (colon[-1] != ':')) {
+        --colon;
+    }
+
+    if (colon == address) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    unsigned long port = 0;
+
+    if ((gs_inet_decimal(colon, end, 5, &port) < 0) || (port > 65535)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* `host_end` points at the ':' in front of the port. */
+    const char *host_end = colon - 1;
+
+    memset(storage, 0, sizeof(struct sockaddr_storage));
+
+    if (address[0] == '[') {
+        if ((host_end - address < 2) || (host_end[-1] != ']')) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        struct sockaddr_in6 *ipv6 = (struct sockaddr_in6 *)storage;
+        const char *begin = address + 1;
+        const char *stop = host_end - 1;
+        const char *percent = memchr(begin, '%', stop - begin);
+
+        if (percent) {
+            if (gs_inet_parse_scope(percent + 1, stop, &ipv6->sin6_scope_id) < 0) {
+                errno = EINVAL;
+                return -1;
+            }
+
+            stop = percent;
+        }
+
+        if (gs_inet_parse_ipv6(begin, stop, ipv6->sin6_addr.s6_addr) < 0) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        ipv6->sin6_family = AF_INET6;
+        ipv6->sin6_port = htons((uint16_t)port);
+        *length = sizeof(struct sockaddr_in6);
+
+        return 0;
+    }
+
+    struct sockaddr_in *ipv4 = (struct sockaddr_in *)storage;
+
+    if (gs_inet_parse_ipv4(address, host_end, (unsigned char *)&ipv4->sin_addr.s_addr) < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    ipv4->sin_family = AF_INET;
+    ipv4->sin_port = htons((uint16_t)port);
+    *length = sizeof(struct sockaddr_in);
+
+    return 0;
+}
+
+int gs_inet_dual_stack(int fd, int family)
+{
+    if (family != AF_INET6) {
+        return 0;
+    }
+
+    const int disable = 0;
+
+    return setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &disable, sizeof(disable));
+}
+
+int gs_inet_format(const struct sockaddr *address, char *buffer, unsigned int length)
+{
+    char host[INET6_ADDRSTRLEN];
+
+    if (address->sa_family == AF_INET) {
+        const struct sockaddr_in *ipv4 = (const struct sockaddr_in *)address;
+
+        inet_ntop(AF_INET, &ipv4->sin_addr, host, sizeof(host));
+
+        return snprintf(buffer, length, "%s:%u", host, ntohs(ipv4->sin_port));
+    }
+
+    if (address->sa_family == AF_INET6) {
+        const struct sockaddr_in6 *ipv6 = (const struct sockaddr_in6 *)address;
+
+        inet_ntop(AF_INET6, &ipv6->sin6_addr, host, sizeof(host));
+
+        return snprintf(buffer, length, "[%s]:%u", host, ntohs(ipv6->sin6_port));
+    }
+
+    errno = EAFNOSUPPORT;
+    return -1;
+}
@@ -0,0 +1,26 @@
+#ifndef GS_INET_H_
+#define GS_INET_H_
+
+#include <sys/socket.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Parses "a.b.c.d:port" or "[v6]:port" (with an optional "%scope") straight
+ * into a sockaddr_in/sockaddr_in6, shared by the TCP and UDP domains.
+ */
+int gs_inet_parse(const char *address, struct sockaddr_storage *storage, socklen_t *length);
+
+/* Lets an AF_INET6 listener accept IPv4 clients too, whatever the net.ipv6.bindv6only default is. */
+int gs_inet_dual_stack(int fd, int family);
+
+/* Formats an AF_INET/AF_INET6 address back to the form gs_inet_parse() reads. */
+int gs_inet_format(const struct sockaddr *address, char *buffer, unsigned int length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* GS_INET_H_ */
@@ -0,0 +1,554 @@
+#include "loop.h"
+#include "gs.h"
+#include "socket.h"
+#include "write_queue.h"
+#include "timer.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+
+#define GS_LOOP_MAX_EVENTS 256
+
+struct gs_loop_t
+{
+    int epoll_fd;
+    int wakeup_fd;
+    int stopping;
+
+    /* Wakes epoll_wait() for the earliest tick of the wheel, `armed` is 0 while disarmed. */
+    int timer_fd;
+    unsigned long long armed;
+    struct gs_timer_wheel_t *wheel;
+
+    /* Monotonic milliseconds, refreshed once per batch of events. */
+    unsigned long long now;
+
+    /* Registered sockets, see gs_loop_drain(). */
+    unsigned int sockets;
+
+    struct epoll_event events[GS_LOOP_MAX_EVENTS];
+};
+
+static inline uint32_t to_epoll_events(unsigned int events)
+{
+    uint32_t epoll_events = EPOLLET | EPOLLRDHUP;
+
+    if (events & GS_LOOP_EVENT_READABLE) {
+        epoll_events |= EPOLLIN | EPOLLPRI;
+    }
+
+    if (events & GS_LOOP_EVENT_WRITABLE) {
+        epoll_events |= EPOLLOUT;
+    }
+
+    if (events & GS_LOOP_FLAG_ONESHOT) {
+        epoll_events |= EPOLLONESHOT;
+    }
+
+    if (events & GS_LOOP_FLAG_EXCLUSIVE) {
+        epoll_events = (epoll_events & (EPOLLIN | EPOLLOUT | EPOLLET)) | EPOLLEXCLUSIVE;
+    }
+
+    return epoll_events;
+}
+
+static inline unsigned int from_epoll_events(uint32_t epoll_events)
+{
+    unsigned int events = 0;
+
+    if (epoll_events & (EPOLLIN | EPOLLPRI)) {
+        events |= GS_LOOP_EVENT_READABLE;
+    }
+
+    if (epoll_events & EPOLLOUT) {
+        events |= GS_LOOP_EVENT_WRITABLE;
+    }
+
+    if (epoll_events & (EPOLLRDHUP | EPOLLHUP)) {
+        events |= GS_LOOP_EVENT_HANGUP;
+    }
+
+    if (epoll_events & EPOLLERR) {
+        events |= GS_LOOP_EVENT_ERROR;
+    }
+
+    return events;
+}
+
+static inline unsigned long long gs_loop_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (unsigned long long)now.tv_sec * 1000 + (unsigned long long)now.tv_nsec / 1000000;
+}
+
+/* The earliest deadline of the socket, 0 when none applies. */
+static unsigned long long gs_loop_socket_deadline(const struct gs_socket_t *gsocket)
+{
+    const unsigned long long last_read = __atomic_load_n(&gsocket->last_read, __ATOMIC_RELAXED);
+    const unsigned long long last_write = __atomic_load_n(&gsocket->last_write, __ATOMIC_RELAXED);
+
+    unsigned long long candidates[4] = { gsocket->connect_deadline, 0, 0, 0 };
+
+    if (gsocket->idle_timeout) {
+        candidates[1] = ((last_read > last_write) ? last_read : last_write) + gsocket->idle_timeout;
+    }
+
+    if (gsocket->read_timeout && (gsocket->events & GS_LOOP_EVENT_READABLE)) {
+        candidates[2] = last_read + gsocket->read_timeout;
+    }
+
+    if (gsocket->write_timeout && (gsocket->events & GS_LOOP_EVENT_WRITABLE)) {
+        candidates[3] = last_write + gsocket->write_timeout;
+    }
+
+    unsigned long long deadline = 0;
+
+    for (unsigned int index = 0; index < 4; ++index) {
+        if (candidates[index] && (!deadline || (candidates[index] < deadline))) {
+            deadline = candidates[index];
+        }
+    }
+
+    return deadline;
+}
+
+/* Makes sure the socket timer fires no later than its earliest deadline. */
+static void gs_loop_socket_schedule(struct gs_loop_t *loop, struct gs_socket_t *gsocket)
+{
+    const unsigned long long deadline = gs_loop_socket_deadline(gsocket);
+
+    if (!deadline) {
+        return;
+    }
+
+    if (gs_timer_pending(&gsocket->timer)) {
+        if (gsocket->timer.expires <= deadline) {
+            return;
+        }
+
+        gs_timer_wheel_remove(loop->wheel, &gsocket->timer);
+    }
+
+    gs_timer_wheel_add(loop->wheel, &gsocket->timer, deadline);
+}
+
+static void gs_loop_socket_expired(struct gs_loop_t *loop, struct gs_timer_t *timer, void *user_data)
+{
+    struct gs_socket_t *gsocket = (struct gs_socket_t *)user_data;
+    const unsigned long long deadline = gs_loop_socket_deadline(gsocket);
+
+    if (!deadline) {
+        return;
+    }
+
+    /* Activity since the timer was set only moved the deadline, catch up with it now. */
+    if (deadline > loop->now) {
+        gs_timer_wheel_add(loop->wheel, timer, deadline);
+        return;
+    }
+
+    const bool connecting = gsocket->connect_deadline && (gsocket->connect_deadline <= loop->now);
+
+    gsocket->connect_deadline = 0;
+    __atomic_store_n(&gsocket->last_read, loop->now, __ATOMIC_RELAXED);
+    __atomic_store_n(&gsocket->last_write, loop->now, __ATOMIC_RELAXED);
+
+    if (!connecting && (gsocket->timeout_flags & GS_LOOP_TIMEOUT_CLOSE)) {
+        shutdown(gsocket->fd, SHUT_RDWR);
+        return;
+    }
+
+    /* Scheduled before the handler runs, it may close the socket. */
+    gs_loop_socket_schedule(loop, gsocket);
+
+    gsocket->handler(loop, gsocket, GS_LOOP_EVENT_TIMEOUT, gsocket->user_data);
+}
+
+/* Points the timerfd at the next tick the wheel has to process. */
+static void gs_loop_arm(struct gs_loop_t *loop)
+{
+    const unsigned long long next = gs_timer_wheel_next(loop->wheel);
+
+    if (next == loop->armed) {
+        return;
+    }
+
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(struct itimerspec));
+    spec.it_value.tv_sec = (time_t)(next / 1000);
+    spec.it_value.tv_nsec = (long)(next % 1000) * 1000000;
+
+    if (timerfd_settime(loop->timer_fd, TFD_TIMER_ABSTIME, &spec, NULL) == 0) {
+        loop->armed = next;
+    }
+}
+
+struct gs_loop_t * gs_loop_create(void)
+{
+    struct gs_loop_t *loop = (struct gs_loop_t *)malloc(sizeof(struct gs_loop_t));
+
+    if (!loop) {
+        return NULL;
+    }
+
+    memset(loop, 0, sizeof(struct gs_loop_t));
+    loop->wakeup_fd = -1;
+    loop->timer_fd = -1;
+
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    loop->wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    loop->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    loop->now = gs_loop_now();
+    loop->wheel = gs_timer_wheel_create(loop->now);
+
+    if ((loop->epoll_fd < 0) || (loop->wakeup_fd < 0) || (loop->timer_fd < 0) || !loop->wheel) {
+        gs_loop_destroy(loop);
+        return NULL;
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(struct epoll_event));
+    event.events = EPOLLIN;
+    event.data.ptr = NULL;
+
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->wakeup_fd, &event) < 0) {
+        gs_loop_destroy(loop);
+        return NULL;
+    }
+
+    event.data.ptr = &loop->timer_fd;
+
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->timer_fd, &event) < 0) {
+        gs_loop_destroy(loop);
+        return NULL;
+    }
+
+    return loop;
+}
+
+void gs_loop_destroy(struct gs_loop_t *loop)
+{
+    if (!loop) {
+        return;
+    }
+
+    if (loop->wakeup_fd >= 0) {
+        close(loop->wakeup_fd);
+    }
+
+    if (loop->timer_fd >= 0) {
+        close(loop->timer_fd);
+    }
+
+    gs_timer_wheel_destroy(loop->wheel);
+
+    if (loop->epoll_fd >= 0) {
+        close(loop->epoll_fd);
+    }
+
+    free(loop);
+}
+
+int gs_loop_add(struct gs_loop_t *loop, struct gs_socket_t *gsocket, unsigned int events, gs_loop_handler_t handler, void *user_data)
+{
+    if (!loop || !gsocket || !handler || (gsocket->fd < 0)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (gsocket->loop) {
+        errno = EEXIST;
+        return -1;
+    }
+
+    if (!(gsocket->flags & GS_SOCKET_FLAG_NONBLOCK)) {
+        const int flags = fcntl(gsocket->fd, F_GETFL);
+
+        if ((flags < 0) || (fcntl(gsocket->fd, F_SETFL, flags | O_NONBLOCK) < 0)) {
+            return -1;
+        }
+
+        gsocket->flags |= GS_SOCKET_FLAG_NONBLOCK;
+    }
+
+    gsocket->loop = loop;
+    gsocket->handler = handler;
+    gsocket->user_data = user_data;
+    gsocket->events = events;
+
+    gs_timer_init(&gsocket->timer, gs_loop_socket_expired, gsocket);
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(struct epoll_event));
+    event.events = to_epoll_events(events);
+    event.data.ptr = gsocket;
+
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, gsocket->fd, &event) < 0) {
+        gsocket->loop = NULL;
+        gsocket->handler = NULL;
+        gsocket->user_data = NULL;
+        gsocket->events = 0;
+        return -1;
+    }
+
+    __atomic_add_fetch(&loop->sockets, 1, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+int gs_loop_rearm(struct gs_loop_t *loop, struct gs_socket_t *gsocket, unsigned int events)
+{
+    if (!loop || !gsocket || (gsocket->loop != loop)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* Keep flushing queued output whatever the handler asked for. */
+    if (gs_write_queue_pending(gsocket)) {
+        events |= gs_socket_output_event(gsocket);
+    }
+
+    /* The write timeout counts from the moment the socket starts waiting for output. */
+    if ((events & GS_LOOP_EVENT_WRITABLE) && !(gsocket->events & GS_LOOP_EVENT_WRITABLE)) {
+        __atomic_store_n(&gsocket->last_write, gs_loop_now(), __ATOMIC_RELAXED);
+    }
+
+    gsocket->events = events;
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(struct epoll_event));
+    event.events = to_epoll_events(events);
+    event.data.ptr = gsocket;
+
+    return epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, gsocket->fd, &event);
+}
+
+int gs_loop_remove(struct gs_loop_t *loop, struct gs_socket_t *gsocket)
+{
+    if (!loop || !gsocket || (gsocket->loop != loop)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    gs_timer_wheel_remove(loop->wheel, &gsocket->timer);
+    gsocket->connect_deadline = 0;
+    gsocket->read_timeout = 0;
+    gsocket->write_timeout = 0;
+    gsocket->idle_timeout = 0;
+    gsocket->timeout_flags = 0;
+
+    gsocket->loop = NULL;
+    gsocket->handler = NULL;
+    gsocket->user_data = NULL;
+    gsocket->events = 0;
+
+    __atomic_sub_fetch(&loop->sockets, 1, __ATOMIC_RELAXED);
+
+    return epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, gsocket->fd, NULL);
+}
+
+int gs_loop_connect(struct gs_loop_t *loop, struct gs_socket_t *gsocket, const char *address, int timeout, gs_loop_handler_t handler, void *user_data)
+{
+    if (!loop || !gsocket || !handler || gsocket->loop) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    const bool pending = (gs_connect_async(gsocket, address) < 0);
+
+    if (pending && (errno != EINPROGRESS)) {
+        return -1;
+    }
+
+    if (gs_loop_add(loop, gsocket, GS_LOOP_EVENT_WRITABLE, handler, user_data) < 0) {
+        return -1;
+    }
+
+    if (pending && (timeout >= 0)) {
+        gsocket->connect_deadline = gs_loop_now() + (unsigned int)timeout;
+        gs_loop_socket_schedule(loop, gsocket);
+    }
+
+    return 0;
+}
+
+int gs_loop_set_timeouts(struct gs_loop_t *loop, struct gs_socket_t *gsocket, unsigned int read, unsigned int write, unsigned int idle, unsigned int flags)
+{
+    if (!loop || !gsocket || (gsocket->loop != loop)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    const unsigned long long now = gs_loop_now();
+
+    gsocket->read_timeout = read;
+    gsocket->write_timeout = write;
+    gsocket->idle_timeout = idle;
+    gsocket->timeout_flags = flags;
+
+    __atomic_store_n(&gsocket->last_read, now, __ATOMIC_RELAXED);
+    __atomic_store_n(&gsocket->last_write, now, __ATOMIC_RELAXED);
+
+    gs_loop_socket_schedule(loop, gsocket);
+
+    return 0;
+}
+
+void gs_timer_init(struct gs_timer_t *timer, gs_timer_handler_t handler, void *user_data)
+{
+    memset(timer, 0, sizeof(struct gs_timer_t));
+
+    timer->handler = handler;
+    timer->user_data = user_data;
+}
+
+int gs_timer_start(struct gs_loop_t *loop, struct gs_timer_t *timer, unsigned int timeout)
+{
+    if (!loop || !timer || !timer->handler) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    gs_timer_wheel_remove(loop->wheel, timer);
+    gs_timer_wheel_add(loop->wheel, timer, gs_loop_now() + timeout);
+
+    return 0;
+}
+
+void gs_timer_stop(struct gs_loop_t *loop, struct gs_timer_t *timer)
+{
+    gs_timer_wheel_remove(loop->wheel, timer);
+}
+
+bool gs_timer_pending(const struct gs_timer_t *timer)
+{
+    return timer->bucket != NULL;
+}
+
+int gs_loop_run_once(struct gs_loop_t *loop, int timeout)
+{
+    gs_loop_arm(loop);
+
+    const int num_events = epoll_wait(loop->epoll_fd, loop->events, GS_LOOP_MAX_EVENTS, timeout);
+
+    if (num_events < 0) {
+        return (errno == EINTR) ? 0 : -1;
+    }
+
+    loop->now = gs_loop_now();
+
+    for (int index = 0; index < num_events; ++index) {
+        struct gs_socket_t *gsocket = (struct gs_socket_t *)loop->events[index].data.ptr;
+
+        if (!gsocket) {
+            uint64_t value = 0;
+            while (read(loop->wakeup_fd, &value, sizeof(value)) > 0);
+            continue;
+        }
+
+        if ((void *)gsocket == (void *)&loop->timer_fd) {
+            uint64_t expirations = 0;
+
+            if (read(loop->timer_fd, &expirations, sizeof(expirations)) < 0) {
+                /* Already consumed, the wheel is advanced below either way. */
+            }
+
+            loop->armed = 0;
+            continue;
+        }
+
+        const unsigned int events = from_epoll_events(loop->events[index].events);
+
+        /* Only timestamps, the socket timer checks them when it fires. */
+        if (events & (GS_LOOP_EVENT_READABLE | GS_LOOP_EVENT_HANGUP)) {
+            __atomic_store_n(&gsocket->last_read, loop->now, __ATOMIC_RELAXED);
+        }
+
+        if (events & GS_LOOP_EVENT_WRITABLE) {
+            __atomic_store_n(&gsocket->last_write, loop->now, __ATOMIC_RELAXED);
+        }
+
+        gsocket->connect_deadline = 0;
+
+        if ((events & gs_socket_output_event(gsocket)) && gsocket->wq) {
+            gs_flush(gsocket);
+        }
+
+        gsocket->handler(loop, gsocket, events, gsocket->user_data);
+    }
+
+    loop->now = gs_loop_now();
+    gs_timer_wheel_advance(loop->wheel, loop, loop->now);
+
+    return num_events;
+}
+
+int gs_loop_run(struct gs_loop_t *loop)
+{
+    int result = 0;
+
+    while (!__atomic_load_n(&loop->stopping, __ATOMIC_ACQUIRE)) {
+        if (gs_loop_run_once(loop, -1) < 0) {
+            result = -1;
+            break;
+        }
+    }
+
+    __atomic_store_n(&loop->stopping, 0, __ATOMIC_RELEASE);
+
+    return result;
+}
+
+unsigned int gs_loop_size(const struct gs_loop_t *loop)
+{
+    return __atomic_load_n(&loop->sockets, __ATOMIC_RELAXED);
+}
+
+int gs_loop_drain(struct gs_loop_t *loop, int timeout)
+{
+    const unsigned long long deadline = (timeout >= 0) ? gs_loop_now() + (unsigned int)timeout : 0;
+
+    while (gs_loop_size(loop) && !__atomic_load_n(&loop->stopping, __ATOMIC_ACQUIRE)) {
+        int wait = -1;
+
+        if (deadline) {
+            const unsigned long long now = gs_loop_now();
+
+            if (now >= deadline) {
+                break;
+            }
+
+            wait = (int)(deadline - now);
+        }
+
+        if (gs_loop_run_once(loop, wait) < 0) {
+            return -1;
+        }
+    }
+
+    __atomic_store_n(&loop->stopping, 0, __ATOMIC_RELEASE);
+
+    return (int)gs_loop_size(loop);
+}
+
+void gs_loop_stop(struct gs_loop_t *loop)
+{
+    const uint64_t value = 1;
+
+    __atomic_store_n(&loop->stopping, 1, __ATOMIC_RELEASE);
+
+    if (write(loop->wakeup_fd, &value, sizeof(value)) < 0) {
+        /* The counter is already non-zero, the loop will wake up anyway. */
+    }
+}
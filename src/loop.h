@@ -0,0 +1,137 @@
+#ifndef GS_LOOP_H_
+#define GS_LOOP_H_
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct gs_socket_t;
+struct gs_loop_t;
+struct gs_timer_t;
+
+enum
+{
+    GS_LOOP_EVENT_READABLE = 0x01,
+    GS_LOOP_EVENT_WRITABLE = 0x02,
+    GS_LOOP_EVENT_HANGUP = 0x04,
+    GS_LOOP_EVENT_ERROR = 0x08,
+    GS_LOOP_EVENT_TIMEOUT = 0x10
+};
+
+enum
+{
+    /* Disarm the socket after each dispatch, gs_loop_rearm() has to be called
+     * before it is reported again. Used when the socket is handed to another
+     * thread. */
+    GS_LOOP_FLAG_ONESHOT = 0x100,
+
+    /* Wake up only one of the loops polling the same listener, only valid
+     * for gs_loop_add() and cannot be combined with GS_LOOP_FLAG_ONESHOT. */
+    GS_LOOP_FLAG_EXCLUSIVE = 0x200
+};
+
+/**
+ * Called on the loop thread with the GS_LOOP_EVENT_* bits that fired.
+ *
+ * Sockets are registered edge-triggered, so the handler has to drain the
+ * socket until EAGAIN. It may close the dispatched socket, but no other one
+ * registered in the same loop.
+ */
+typedef void (*gs_loop_handler_t)(struct gs_loop_t *loop, struct gs_socket_t *gsocket, unsigned int events, void *user_data);
+
+typedef void (*gs_timer_handler_t)(struct gs_loop_t *loop, struct gs_timer_t *timer, void *user_data);
+
+/* Embedded by its owner and initialised with gs_timer_init(), the fields are private. */
+struct gs_timer_t
+{
+    unsigned long long expires;
+    struct gs_timer_t *prev;
+    struct gs_timer_t *next;
+    struct gs_timer_t **bucket;
+
+    gs_timer_handler_t handler;
+    void *user_data;
+};
+
+enum
+{
+    /* Shut an expired connection down instead of reporting GS_LOOP_EVENT_TIMEOUT,
+     * the handler then sees it hang up and closes it as usual. */
+    GS_LOOP_TIMEOUT_CLOSE = 0x01
+};
+
+struct gs_loop_t * gs_loop_create(void);
+
+void gs_loop_destroy(struct gs_loop_t *loop);
+
+/* Registers the socket and switches it to non-blocking mode. */
+int gs_loop_add(struct gs_loop_t *loop, struct gs_socket_t *gsocket, unsigned int events, gs_loop_handler_t handler, void *user_data);
+
+/* Changes the interest set. Also re-arms a GS_LOOP_FLAG_ONESHOT socket, safe from any thread. */
+int gs_loop_rearm(struct gs_loop_t *loop, struct gs_socket_t *gsocket, unsigned int events);
+
+int gs_loop_remove(struct gs_loop_t *loop, struct gs_socket_t *gsocket);
+
+/**
+ * Starts a non-blocking connect and registers the socket for writability.
+ * The handler sees GS_LOOP_EVENT_WRITABLE once the handshake finished (check
+ * gs_connect_result()), or GS_LOOP_EVENT_TIMEOUT if it did not complete
+ * within timeout milliseconds (-1 for no deadline). The socket stays
+ * registered either way.
+ */
+int gs_loop_connect(struct gs_loop_t *loop, struct gs_socket_t *gsocket, const char *address, int timeout, gs_loop_handler_t handler, void *user_data);
+
+/**
+ * Sets per-connection deadlines in milliseconds, 0 disables one: `read`
+ * bounds the time between readable events while the socket waits for
+ * input, `write` the time between writable events while it waits for
+ * output, and `idle` the time without either. The handler sees
+ * GS_LOOP_EVENT_TIMEOUT when one passes, after which they start over.
+ *
+ * Activity only records a timestamp; the single wheel timer of the
+ * socket is moved when it fires early, so busy connections cost nothing.
+ * Must be called on the loop thread, after gs_loop_add().
+ */
+int gs_loop_set_timeouts(struct gs_loop_t *loop, struct gs_socket_t *gsocket, unsigned int read, unsigned int write, unsigned int idle, unsigned int flags);
+
+void gs_timer_init(struct gs_timer_t *timer, gs_timer_handler_t handler, void *user_data);
+
+/**
+ * (Re)starts a one-shot timer firing on the loop thread after `timeout`
+ * milliseconds. Starting and stopping are O(1) and expiries are driven by
+ * a timerfd, so an idle loop only wakes up when a timer is due. Timers
+ * belong to the loop thread.
+ */
+int gs_timer_start(struct gs_loop_t *loop, struct gs_timer_t *timer, unsigned int timeout);
+
+void gs_timer_stop(struct gs_loop_t *loop, struct gs_timer_t *timer);
+
+bool gs_timer_pending(const struct gs_timer_t *timer);
+
+/* Waits up to timeout milliseconds (-1 for infinite) and dispatches one batch of events. */
+int gs_loop_run_once(struct gs_loop_t *loop, int timeout);
+
+/* Dispatches events until gs_loop_stop() is called. */
+int gs_loop_run(struct gs_loop_t *loop);
+
+/* Number of sockets registered in the loop. */
+unsigned int gs_loop_size(const struct gs_loop_t *loop);
+
+/**
+ * Dispatches events until no socket is registered any more, for a process
+ * that stopped accepting and lets its connections finish (see
+ * gs_handoff_serve()). Gives up after timeout milliseconds (-1 for none)
+ * or on gs_loop_stop(). Returns the number of sockets still registered.
+ */
+int gs_loop_drain(struct gs_loop_t *loop, int timeout);
+
+/* Async-signal-safe, can be called from any thread. */
+void gs_loop_stop(struct gs_loop_t *loop);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* GS_LOOP_H_ */
@@ -0,0 +1,338 @@
+#include "message.h"
+#include "socket.h"
+#include "write_queue.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <poll.h>
+
+/* Frames coalesced into one sendmsg(), two iovecs each. */
+#define GS_MSG_SEND_BATCH 64
+
+/* Room kept after the largest frame so that one recv() can pick up several frames. */
+#define GS_MSG_READ_AHEAD (16 * 1024)
+
+struct gs_msg_buffer_t
+{
+    char *data;
+    unsigned int capacity;
+    unsigned int max_frame;
+
+    /* Unconsumed bytes live in [begin, end). */
+    unsigned int begin;
+    unsigned int end;
+};
+
+static struct gs_msg_buffer_t * gs_msg_buffer(struct gs_socket_t *gsocket)
+{
+    if (!gsocket->rx) {
+        gsocket->rx = (struct gs_msg_buffer_t *)calloc(1, sizeof(struct gs_msg_buffer_t));
+
+        if (gsocket->rx) {
+            gsocket->rx->max_frame = GS_MSG_DEFAULT_MAX_FRAME;
+        }
+    }
+
+    return gsocket->rx;
+}
+
+void gs_msg_buffer_destroy(struct gs_msg_buffer_t *buffer)
+{
+    if (!buffer) {
+        return;
+    }
+
+    free(buffer->data);
+    free(buffer);
+}
+
+int gs_msg_set_max_frame(struct gs_socket_t *gsocket, unsigned int max_frame)
+{
+    if (!max_frame || (max_frame > UINT32_MAX - GS_MSG_HEADER_SIZE - GS_MSG_READ_AHEAD)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    struct gs_msg_buffer_t *buffer = gs_msg_buffer(gsocket);
+
+    if (!buffer) {
+        return -1;
+    }
+
+    const unsigned int pending = buffer->end - buffer->begin;
+    const unsigned int capacity = max_frame + GS_MSG_HEADER_SIZE + GS_MSG_READ_AHEAD;
+
+    if (buffer->data && (pending > capacity)) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    if (buffer->data) {
+        memmove(buffer->data, buffer->data + buffer->begin, pending);
+        buffer->begin = 0;
+        buffer->end = pending;
+
+        char *data = (char *)realloc(buffer->data, capacity);
+
+        if (!data) {
+            return -1;
+        }
+
+        buffer->data = data;
+        buffer->capacity = capacity;
+    }
+
+    buffer->max_frame = max_frame;
+
+    return 0;
+}
+
+/* Skips `bytes` already written from the front of the iovec array. */
+static unsigned int gs_msg_advance(struct iovec *iov, unsigned int count, size_t bytes)
+{
+    unsigned int index = 0;
+
+    while ((index < count) && (bytes >= iov[index].iov_len)) {
+        bytes -= iov[index].iov_len;
+        ++index;
+    }
+
+    if (index < count) {
+        iov[index].iov_base = (char *)iov[index].iov_base + bytes;
+        iov[index].iov_len -= bytes;
+    }
+
+    return index;
+}
+
+static int gs_msg_wait_writable(struct gs_socket_t *gsocket)
+{
+    struct pollfd pollfd;
+    memset(&pollfd, 0, sizeof(struct pollfd));
+    pollfd.fd = gsocket->fd;
+
+    /* A full shared-memory ring leaves the socket writable, freed space arrives as a wakeup to read. */
+    pollfd.events = (gs_socket_output_event(gsocket) == GS_LOOP_EVENT_READABLE) ? POLLIN : POLLOUT;
+
+    /* Bounded like a loop's write timeout, a reader that stalls must not hold the caller forever. */
+    const int timeout = gsocket->write_timeout ? (int)gsocket->write_timeout : -1;
+    int result = 0;
+
+    do {
+        result = poll(&pollfd, 1, timeout);
+    } while ((result < 0) && (errno == EINTR));
+
+    if (result == 0) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+
+    return (result < 0) ? -1 : 0;
+}
+
+static inline void gs_msg_header(unsigned char *header, uint32_t length)
+{
+    header[0] = (unsigned char)(length >> 24);
+    header[1] = (unsigned char)(length >> 16);
+    header[2] = (unsigned char)(length >> 8);
+    header[3] = (unsigned char)length;
+}
+
+/* Copies whole frames into the socket's write queue, behind what is queued already. */
+static int gs_msg_queue_frames(struct gs_socket_t *gsocket, const struct iovec *frames, unsigned int count)
+{
+    for (unsigned int index = 0; index < count; ++index) {
+        unsigned char header[GS_MSG_HEADER_SIZE];
+
+        gs_msg_header(header, (uint32_t)frames[index].iov_len);
+
+        if ((gs_write(gsocket, header, GS_MSG_HEADER_SIZE) < 0) ||
+            (gs_write(gsocket, frames[index].iov_base, (unsigned int)frames[index].iov_len) < 0)) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* Queues the unsent rest of a batch and the frames after it, the loop sends them once the socket drains. */
+static int gs_msg_queue_tail(struct gs_socket_t *gsocket, const struct iovec *iov, unsigned int count, const struct iovec *frames, unsigned int frames_count)
+{
+    for (unsigned int index = 0; index < count; ++index) {
+        if (gs_write(gsocket, iov[index].iov_base, (unsigned int)iov[index].iov_len) < 0) {
+            return -1;
+        }
+    }
+
+    if (gs_msg_queue_frames(gsocket, frames, frames_count) < 0) {
+        return -1;
+    }
+
+    return (gs_flush(gsocket) < 0) ? -1 : 0;
+}
+
+int gs_msg_send_batch(struct gs_socket_t *gsocket, const struct iovec *frames, unsigned int count, int flags)
+{
+    const unsigned int max_frame = gsocket->rx ? gsocket->rx->max_frame : GS_MSG_DEFAULT_MAX_FRAME;
+
+    size_t total = 0;
+
+    for (unsigned int index = 0; index < count; ++index) {
+        if (frames[index].iov_len > max_frame) {
+            errno = EMSGSIZE;
+            return -1;
+        }
+
+        total += frames[index].iov_len;
+    }
+
+    /* Sending around queued output would reorder the stream. */
+    if (gs_write_queue_pending(gsocket)) {
+        return (gs_msg_queue_tail(gsocket, NULL, 0, frames, count) < 0) ? -1 : (int)total;
+    }
+
+    unsigned char headers[GS_MSG_SEND_BATCH][GS_MSG_HEADER_SIZE];
+    struct iovec iov[GS_MSG_SEND_BATCH * 2];
+    size_t payload = 0;
+
+    for (unsigned int first = 0; first < count; first += GS_MSG_SEND_BATCH) {
+        const unsigned int batch = ((count - first) < GS_MSG_SEND_BATCH) ? (count - first) : GS_MSG_SEND_BATCH;
+        size_t remaining = 0;
+
+        for (unsigned int index = 0; index < batch; ++index) {
+            const uint32_t length = (uint32_t)frames[first + index].iov_len;
+
+            gs_msg_header(headers[index], length);
+
+            iov[index * 2].iov_base = headers[index];
+            iov[index * 2].iov_len = GS_MSG_HEADER_SIZE;
+            iov[index * 2 + 1] = frames[first + index];
+
+            remaining += GS_MSG_HEADER_SIZE + length;
+        }
+
+        struct iovec *cursor = iov;
+        unsigned int cursor_count = batch * 2;
+        bool started = (first > 0);
+
+        while (remaining) {
+            const int bytes = gsocket->base->sendv(gsocket, cursor, cursor_count, flags | MSG_NOSIGNAL);
+
+            if (bytes < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+
+                if (((errno == EAGAIN) || (errno == EWOULDBLOCK)) && started) {
+                    if (gsocket->wq) {
+                        const unsigned int next = first + batch;
+
+                        return (gs_msg_queue_tail(gsocket, cursor, cursor_count, frames + next, count - next) < 0) ? -1 : (int)total;
+                    }
+
+                    if (gs_msg_wait_writable(gsocket) < 0) {
+                        return -1;
+                    }
+
+                    continue;
+                }
+
+                return -1;
+            }
+
+            started = true;
+            remaining -= bytes;
+
+            const unsigned int skipped = gs_msg_advance(cursor, cursor_count, bytes);
+            cursor += skipped;
+            cursor_count -= skipped;
+        }
+
+        for (unsigned int index = 0; index < batch; ++index) {
+            payload += frames[first + index].iov_len;
+        }
+    }
+
+    return (int)payload;
+}
+
+int gs_msg_send(struct gs_socket_t *gsocket, const void *data, unsigned int length, int flags)
+{
+    const struct iovec frame = {
+        .iov_base = (void *)data,
+        .iov_len = length
+    };
+
+    return gs_msg_send_batch(gsocket, &frame, 1, flags);
+}
+
+int gs_msg_recv(struct gs_socket_t *gsocket, const void **frame, unsigned int *length)
+{
+    struct gs_msg_buffer_t *buffer = gs_msg_buffer(gsocket);
+
+    if (!buffer) {
+        return -1;
+    }
+
+    if (!buffer->data) {
+        buffer->capacity = buffer->max_frame + GS_MSG_HEADER_SIZE + GS_MSG_READ_AHEAD;
+        buffer->data = (char *)malloc(buffer->capacity);
+
+        if (!buffer->data) {
+            return -1;
+        }
+    }
+
+    while (true) {
+        unsigned int pending = buffer->end - buffer->begin;
+        unsigned int required = GS_MSG_HEADER_SIZE;
+
+        if (pending >= GS_MSG_HEADER_SIZE) {
+            const unsigned char *header = (const unsigned char *)buffer->data + buffer->begin;
+            const uint32_t frame_length = ((uint32_t)header[0] << 24) | ((uint32_t)header[1] << 16) | ((uint32_t)header[2] << 8) | header[3];
+
+            if (frame_length > buffer->max_frame) {
+                errno = EMSGSIZE;
+                return -1;
+            }
+
+            required += frame_length;
+
+            if (pending >= required) {
+                *frame = header + GS_MSG_HEADER_SIZE;
+                *length = frame_length;
+                buffer->begin += required;
+                return 1;
+            }
+        }
+
+        if (pending == 0) {
+            buffer->begin = 0;
+            buffer->end = 0;
+        }
+        else if (buffer->begin + required > buffer->capacity) {
+            memmove(buffer->data, buffer->data + buffer->begin, pending);
+            buffer->begin = 0;
+            buffer->end = pending;
+        }
+
+        const int bytes = gsocket->base->recv(gsocket, buffer->data + buffer->end, buffer->capacity - buffer->end, 0);
+
+        if (bytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return -1;
+        }
+
+        if (bytes == 0) {
+            return 0;
+        }
+
+        buffer->end += bytes;
+    }
+}
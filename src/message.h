@@ -0,0 +1,48 @@
+#ifndef GS_MESSAGE_H_
+#define GS_MESSAGE_H_
+
+#include <sys/uio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct gs_socket_t;
+
+/**
+ * Length-prefixed framing on top of stream sockets. Every frame is sent as
+ * a 4-byte big-endian length followed by the payload.
+ */
+#define GS_MSG_HEADER_SIZE 4
+#define GS_MSG_DEFAULT_MAX_FRAME (64 * 1024)
+
+/* Frames larger than max_frame are rejected with EMSGSIZE on both sides. */
+int gs_msg_set_max_frame(struct gs_socket_t *gsocket, unsigned int max_frame);
+
+/**
+ * Sends one frame. Once part of a frame is written the call never returns
+ * EAGAIN, so frames are never torn: with a write queue (see
+ * gs_write_queue_enable()) the rest is queued and sent by the loop,
+ * otherwise the call waits for the socket, failing with ETIMEDOUT after
+ * the write timeout of gs_loop_set_timeouts() if one is set. Frames are
+ * queued behind output the queue still holds. Returns the payload length.
+ */
+int gs_msg_send(struct gs_socket_t *gsocket, const void *data, unsigned int length, int flags);
+
+/* Sends `count` frames with as few syscalls as possible. Returns the number of payload bytes. */
+int gs_msg_send_batch(struct gs_socket_t *gsocket, const struct iovec *frames, unsigned int count, int flags);
+
+/**
+ * Returns 1 and points `frame` into the connection's receive buffer when a
+ * complete frame is available, reading as much as the socket holds in one
+ * recv() otherwise. The frame stays valid until the next call. Returns 0
+ * when the peer closed the stream, and -1 with errno EAGAIN on a
+ * non-blocking socket that has no complete frame yet.
+ */
+int gs_msg_recv(struct gs_socket_t *gsocket, const void **frame, unsigned int *length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* GS_MESSAGE_H_ */
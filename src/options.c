@@ -0,0 +1,160 @@
+#include "options.h"
+#include "socket.h"
+
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define GS_SOCKET_BULK_BUFFER (4 * 1024 * 1024)
+
+void gs_socket_opts_preset(struct gs_socket_opts_t *opts, int profile)
+{
+    memset(opts, 0, sizeof(struct gs_socket_opts_t));
+    opts->incoming_cpu = -1;
+
+    switch (profile) {
+        case GS_SOCKET_PROFILE_LOW_LATENCY:
+            opts->nodelay = true;
+            opts->quickack = true;
+            break;
+        case GS_SOCKET_PROFILE_BULK:
+            opts->sndbuf = GS_SOCKET_BULK_BUFFER;
+            opts->rcvbuf = GS_SOCKET_BULK_BUFFER;
+            break;
+        default:
+            break;
+    }
+}
+
+static inline int gs_socket_option(int fd, int level, int name, int value)
+{
+    return setsockopt(fd, level, name, &value, sizeof(value));
+}
+
+int gs_socket_apply_opts(const struct gs_socket_t *gsocket, int fd, int role)
+{
+    if (!(gsocket->flags & GS_SOCKET_FLAG_OPTS)) {
+        return 0;
+    }
+
+    const struct gs_socket_opts_t *opts = &gsocket->opts;
+
+    /* Accepted clients already inherit the listener's buffer sizes. */
+    if (role != GS_SOCKET_ROLE_ACCEPTED) {
+        if (opts->sndbuf && (gs_socket_option(fd, SOL_SOCKET, SO_SNDBUF, opts->sndbuf) < 0)) {
+            return -1;
+        }
+
+        if (opts->rcvbuf && (gs_socket_option(fd, SOL_SOCKET, SO_RCVBUF, opts->rcvbuf) < 0)) {
+            return -1;
+        }
+    }
+
+    if (opts->busy_poll && (gs_socket_option(fd, SOL_SOCKET, SO_BUSY_POLL, opts->busy_poll) < 0)) {
+        return -1;
+    }
+
+    if ((opts->incoming_cpu >= 0) && (gs_socket_option(fd, SOL_SOCKET, SO_INCOMING_CPU, opts->incoming_cpu) < 0)) {
+        return -1;
+    }
+
+    if (gsocket->domain != GS_SOCKET_DOMAIN_TCP) {
+        return 0;
+    }
+
+    if (role == GS_SOCKET_ROLE_LISTENER) {
+        if (opts->fastopen && (gs_socket_option(fd, IPPROTO_TCP, TCP_FASTOPEN, opts->fastopen) < 0)) {
+            return -1;
+        }
+
+        if (opts->defer_accept && (gs_socket_option(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, opts->defer_accept) < 0)) {
+            return -1;
+        }
+
+        return 0;
+    }
+
+    if ((role == GS_SOCKET_ROLE_CLIENT) && opts->fastopen && (gs_socket_option(fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, 1) < 0)) {
+        return -1;
+    }
+
+    if (opts->nodelay && (gs_socket_option(fd, IPPROTO_TCP, TCP_NODELAY, 1) < 0)) {
+        return -1;
+    }
+
+    if (opts->cork && (gs_socket_option(fd, IPPROTO_TCP, TCP_CORK, 1) < 0)) {
+        return -1;
+    }
+
+    /* The kernel clears quickack again by itself, this only covers the start of the connection. */
+    if (opts->quickack && (gs_socket_option(fd, IPPROTO_TCP, TCP_QUICKACK, 1) < 0)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int gs_socket_inherit_opts(struct gs_socket_t *client, const struct gs_socket_t *listener)
+{
+    if (!(listener->flags & GS_SOCKET_FLAG_OPTS)) {
+        return 0;
+    }
+
+    client->opts = listener->opts;
+    client->flags |= GS_SOCKET_FLAG_OPTS;
+
+    return gs_socket_apply_opts(client, client->fd, GS_SOCKET_ROLE_ACCEPTED);
+}
+
+/* Tells from the descriptor itself, a listener autobound with gs_bind("") records no address. */
+static int gs_socket_role(int fd)
+{
+    int listening = 0;
+    socklen_t length = sizeof(listening);
+
+    if ((getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &length) == 0) && listening) {
+        return GS_SOCKET_ROLE_LISTENER;
+    }
+
+    struct sockaddr_storage peer;
+    length = sizeof(peer);
+
+    if (getpeername(fd, (struct sockaddr *)&peer, &length) == 0) {
+        return GS_SOCKET_ROLE_CONNECTED;
+    }
+
+    return GS_SOCKET_ROLE_CLIENT;
+}
+
+int gs_socket_set_opts(struct gs_socket_t *gsocket, const struct gs_socket_opts_t *opts)
+{
+    if (!opts) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    gsocket->opts = *opts;
+    gsocket->flags |= GS_SOCKET_FLAG_OPTS;
+
+    if (opts->reuseport) {
+        gsocket->flags |= GS_SOCKET_FLAG_REUSEPORT;
+    }
+
+    if (gsocket->fd < 0) {
+        return 0;
+    }
+
+    return gs_socket_apply_opts(gsocket, gsocket->fd, gs_socket_role(gsocket->fd));
+}
+
+int gs_socket_cork(struct gs_socket_t *gsocket, bool enable)
+{
+    if (gsocket->domain != GS_SOCKET_DOMAIN_TCP) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    return gs_socket_option(gsocket->fd, IPPROTO_TCP, TCP_CORK, enable ? 1 : 0);
+}
@@ -0,0 +1,68 @@
+#ifndef GS_OPTIONS_H_
+#define GS_OPTIONS_H_
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct gs_socket_t;
+
+enum
+{
+    GS_SOCKET_PROFILE_DEFAULT = 0,
+
+    /* TCP_NODELAY and TCP_QUICKACK for request/response traffic. */
+    GS_SOCKET_PROFILE_LOW_LATENCY,
+
+    /* Large fixed buffers for streaming, Nagle left on. */
+    GS_SOCKET_PROFILE_BULK
+};
+
+/**
+ * Socket tuning, applied when the descriptor is created by gs_bind() or
+ * gs_connect() and inherited by accepted clients. Zero keeps the kernel
+ * default, TCP-level options are ignored outside the TCP domain. Start
+ * from gs_socket_opts_preset() so that unset fields get the right values.
+ */
+struct gs_socket_opts_t
+{
+    /* SO_SNDBUF/SO_RCVBUF in bytes, setting them disables autotuning. */
+    int sndbuf;
+    int rcvbuf;
+
+    bool nodelay;
+    bool cork;
+    bool quickack;
+    bool reuseport;
+
+    /* SO_BUSY_POLL in microseconds, raising it above net.core.busy_read needs CAP_NET_ADMIN. */
+    int busy_poll;
+
+    /* TCP_FASTOPEN queue length on listeners, TCP_FASTOPEN_CONNECT on clients when non-zero. */
+    int fastopen;
+
+    /* TCP_DEFER_ACCEPT in seconds, listeners only. */
+    int defer_accept;
+
+    /* SO_INCOMING_CPU, -1 leaves it unset. */
+    int incoming_cpu;
+};
+
+void gs_socket_opts_preset(struct gs_socket_opts_t *opts, int profile);
+
+/**
+ * Stores the options for the socket's descriptor, applying them right away
+ * if it is already open. A connected client skips the connect-time ones.
+ */
+int gs_socket_set_opts(struct gs_socket_t *gsocket, const struct gs_socket_opts_t *opts);
+
+/* Toggles TCP_CORK, uncorking sends the partial frames held back. */
+int gs_socket_cork(struct gs_socket_t *gsocket, bool enable);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* GS_OPTIONS_H_ */
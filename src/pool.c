@@ -0,0 +1,135 @@
+#include "pool.h"
+#include "gs.h"
+#include "queue.h"
+#include "socket.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <errno.h>
+
+struct gs_pool_t
+{
+    GS_SOCKET_DOMAIN_TYPE domain;
+    struct gs_addr_t *address;
+
+    /* Idle connections. */
+    struct gs_queue_t *idle;
+
+    /* Connections open, idle or handed out. */
+    unsigned int open;
+    unsigned int capacity;
+};
+
+/**
+ * An idle connection has nothing to read, so a peek that would block means
+ * it is alive. EOF means the peer closed it, and unexpected data or an
+ * error leaves it in an unknown state.
+ */
+static bool gs_pool_healthy(struct gs_socket_t *gsocket)
+{
+    char byte = 0;
+
+    const int bytes = gsocket->base->recv(gsocket, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+
+    return (bytes < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK));
+}
+
+struct gs_pool_t * gs_pool_create(GS_SOCKET_DOMAIN_TYPE domain, const char *address, unsigned int capacity)
+{
+    if (!capacity || ((domain != GS_SOCKET_DOMAIN_TCP) && (domain != GS_SOCKET_DOMAIN_UNIX) && (domain != GS_SOCKET_DOMAIN_UNIX_SEQPACKET))) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    struct gs_pool_t *pool = (struct gs_pool_t *)calloc(1, sizeof(struct gs_pool_t));
+
+    if (!pool) {
+        return NULL;
+    }
+
+    pool->domain = domain;
+    pool->capacity = capacity;
+    pool->address = gs_addr_resolve(domain, address);
+    pool->idle = gs_queue_create(capacity);
+
+    if (!pool->address || !pool->idle) {
+        gs_pool_destroy(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+void gs_pool_destroy(struct gs_pool_t *pool)
+{
+    if (!pool) {
+        return;
+    }
+
+    if (pool->idle) {
+        void *item = NULL;
+
+        while (gs_queue_pop(pool->idle, &item) == 0) {
+            gs_close((struct gs_socket_t *)item);
+        }
+
+        gs_queue_destroy(pool->idle);
+    }
+
+    gs_addr_destroy(pool->address);
+    free(pool);
+}
+
+struct gs_socket_t * gs_pool_get(struct gs_pool_t *pool)
+{
+    void *item = NULL;
+
+    while (gs_queue_pop(pool->idle, &item) == 0) {
+        struct gs_socket_t *gsocket = (struct gs_socket_t *)item;
+
+        if (gs_pool_healthy(gsocket)) {
+            return gsocket;
+        }
+
+        gs_pool_discard(pool, gsocket);
+    }
+
+    /* Reserve a slot before connecting so concurrent callers cannot exceed the capacity. */
+    unsigned int open = __atomic_load_n(&pool->open, __ATOMIC_RELAXED);
+
+    do {
+        if (open >= pool->capacity) {
+            errno = EAGAIN;
+            return NULL;
+        }
+    } while (!__atomic_compare_exchange_n(&pool->open, &open, open + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    struct gs_socket_t *gsocket = gs_socket(pool->domain);
+
+    if (!gsocket) {
+        __atomic_sub_fetch(&pool->open, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    if (gs_connect_addr(gsocket, pool->address) < 0) {
+        gs_close(gsocket);
+        __atomic_sub_fetch(&pool->open, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    return gsocket;
+}
+
+void gs_pool_put(struct gs_pool_t *pool, struct gs_socket_t *gsocket)
+{
+    if (gs_queue_push(pool->idle, gsocket) < 0) {
+        gs_pool_discard(pool, gsocket);
+    }
+}
+
+void gs_pool_discard(struct gs_pool_t *pool, struct gs_socket_t *gsocket)
+{
+    gs_close(gsocket);
+
+    __atomic_sub_fetch(&pool->open, 1, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,40 @@
+#ifndef GS_POOL_H_
+#define GS_POOL_H_
+
+#include "domain.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct gs_socket_t;
+struct gs_pool_t;
+
+/**
+ * Keeps up to `capacity` connections to one destination for reuse. The
+ * address is resolved once, connections are opened lazily by gs_pool_get().
+ * Only connection-oriented domains are supported.
+ */
+struct gs_pool_t * gs_pool_create(GS_SOCKET_DOMAIN_TYPE domain, const char *address, unsigned int capacity);
+
+/* Closes the idle connections, the ones handed out must have been returned. */
+void gs_pool_destroy(struct gs_pool_t *pool);
+
+/**
+ * Hands out an idle connection that is still healthy, or connects a new
+ * one. Fails with EAGAIN once `capacity` connections are in use. Safe to
+ * call from any thread.
+ */
+struct gs_socket_t * gs_pool_get(struct gs_pool_t *pool);
+
+/* Returns a connection for reuse, it must have no response left unread. */
+void gs_pool_put(struct gs_pool_t *pool, struct gs_socket_t *gsocket);
+
+/* Closes a connection that failed instead of returning it. */
+void gs_pool_discard(struct gs_pool_t *pool, struct gs_socket_t *gsocket);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* GS_POOL_H_ */
@@ -0,0 +1,121 @@
+#include "queue.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define GS_CACHELINE_SIZE 64
+
+struct gs_queue_cell_t
+{
+    size_t sequence;
+    void *item;
+};
+
+/* Producers and consumers spin on different cache lines. */
+struct gs_queue_t
+{
+    struct gs_queue_cell_t *cells;
+    size_t mask;
+    char padding0[GS_CACHELINE_SIZE - sizeof(void *) - sizeof(size_t)];
+
+    size_t enqueue_position;
+    char padding1[GS_CACHELINE_SIZE - sizeof(size_t)];
+
+    size_t dequeue_position;
+    char padding2[GS_CACHELINE_SIZE - sizeof(size_t)];
+};
+
+struct gs_queue_t * gs_queue_create(unsigned int capacity)
+{
+    size_t size = 2;
+
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    struct gs_queue_t *queue = (struct gs_queue_t *)malloc(sizeof(struct gs_queue_t));
+
+    if (!queue) {
+        return NULL;
+    }
+
+    memset(queue, 0, sizeof(struct gs_queue_t));
+
+    queue->cells = (struct gs_queue_cell_t *)malloc(size * sizeof(struct gs_queue_cell_t));
+
+    if (!queue->cells) {
+        free(queue);
+        return NULL;
+    }
+
+    for (size_t index = 0; index < size; ++index) {
+        queue->cells[index].sequence = index;
+        queue->cells[index].item = NULL;
+    }
+
+    queue->mask = size - 1;
+
+    return queue;
+}
+
+void gs_queue_destroy(struct gs_queue_t *queue)
+{
+    if (!queue) {
+        return;
+    }
+
+    free(queue->cells);
+    free(queue);
+}
+
+int gs_queue_push(struct gs_queue_t *queue, void *item)
+{
+    size_t position = __atomic_load_n(&queue->enqueue_position, __ATOMIC_RELAXED);
+
+    while (true) {
+        struct gs_queue_cell_t *cell = queue->cells + (position & queue->mask);
+        const size_t sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        const intptr_t diff = (intptr_t)sequence - (intptr_t)position;
+
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&queue->enqueue_position, &position, position + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                cell->item = item;
+                __atomic_store_n(&cell->sequence, position + 1, __ATOMIC_RELEASE);
+                return 0;
+            }
+        }
+        else if (diff < 0) {
+            return -1;
+        }
+        else {
+            position = __atomic_load_n(&queue->enqueue_position, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+int gs_queue_pop(struct gs_queue_t *queue, void **item)
+{
+    size_t position = __atomic_load_n(&queue->dequeue_position, __ATOMIC_RELAXED);
+
+    while (true) {
+        struct gs_queue_cell_t *cell = queue->cells + (position & queue->mask);
+        const size_t sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        const intptr_t diff = (intptr_t)sequence - (intptr_t)(position + 1);
+
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&queue->dequeue_position, &position, position + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                *item = cell->item;
+                __atomic_store_n(&cell->sequence, position + queue->mask + 1, __ATOMIC_RELEASE);
+                return 0;
+            }
+        }
+        else if (diff < 0) {
+            return -1;
+        }
+        else {
+            position = __atomic_load_n(&queue->dequeue_position, __ATOMIC_RELAXED);
+        }
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef GS_QUEUE_H_
+#define GS_QUEUE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Bounded lock-free multi-producer/multi-consumer queue of pointers.
+ * The capacity is rounded up to a power of two.
+ */
+struct gs_queue_t;
+
+struct gs_queue_t * gs_queue_create(unsigned int capacity);
+
+void gs_queue_destroy(struct gs_queue_t *queue);
+
+/* Returns -1 when the queue is full. */
+int gs_queue_push(struct gs_queue_t *queue, void *item);
+
+/* Returns -1 when the queue is empty. */
+int gs_queue_pop(struct gs_queue_t *queue, void **item);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* GS_QUEUE_H_ */
@@ -0,0 +1,295 @@
+#include "server.h"
+#include "socket.h"
+#include "gs.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+
+#define GS_SERVER_ACCEPT_BATCH 64
+
+/* Milliseconds before draining the backlog again after running out of descriptors or memory. */
+#define GS_SERVER_ACCEPT_RETRY 100
+
+struct gs_reactor_t
+{
+    struct gs_server_t *server;
+    unsigned int index;
+
+    struct gs_loop_t *loop;
+    struct gs_socket_t *listener;
+
+    /* The listener is edge-triggered, clients left queued by a failed drain wait for this. */
+    struct gs_timer_t retry;
+
+    pthread_t thread;
+    bool running;
+};
+
+struct gs_server_t
+{
+    struct gs_server_config_t config;
+
+    gs_server_handler_t handler;
+    void *user_data;
+
+    /* Owns the bound address when the listener is shared. */
+    struct gs_socket_t *listener;
+
+    unsigned int reactors_size;
+    struct gs_reactor_t *reactors;
+};
+
+static void gs_server_accept(struct gs_loop_t *loop, struct gs_socket_t *gsocket, unsigned int events, void *user_data)
+{
+    (void)events;
+
+    struct gs_reactor_t *reactor = (struct gs_reactor_t *)user_data;
+    struct gs_socket_t *clients[GS_SERVER_ACCEPT_BATCH];
+
+    while (true) {
+        const int count = gs_accept_batch(gsocket, clients, NULL, GS_SERVER_ACCEPT_BATCH, GS_ACCEPT_NONBLOCK | GS_ACCEPT_CLOEXEC);
+
+        if (count < 0) {
+            if ((errno == EMFILE) || (errno == ENFILE) || (errno == ENOBUFS) || (errno == ENOMEM)) {
+                gs_timer_start(loop, &reactor->retry, GS_SERVER_ACCEPT_RETRY);
+            }
+
+            break;
+        }
+
+        for (int index = 0; index < count; ++index) {
+            reactor->server->handler(loop, clients[index], reactor->server->user_data);
+        }
+    }
+}
+
+static void gs_server_retry(struct gs_loop_t *loop, struct gs_timer_t *timer, void *user_data)
+{
+    (void)timer;
+
+    struct gs_reactor_t *reactor = (struct gs_reactor_t *)user_data;
+
+    gs_server_accept(loop, reactor->listener, GS_LOOP_EVENT_READABLE, reactor);
+}
+
+static void * gs_reactor_routine(void *user_data)
+{
+    struct gs_reactor_t *reactor = (struct gs_reactor_t *)user_data;
+
+    gs_loop_run(reactor->loop);
+
+    return NULL;
+}
+
+static struct gs_socket_t * gs_server_listen(GS_SOCKET_DOMAIN_TYPE domain, const char *address, int backlog, unsigned int flags, const struct gs_socket_opts_t *opts)
+{
+    struct gs_socket_t *gsocket = gs_socket(domain);
+
+    if (!gsocket) {
+        return NULL;
+    }
+
+    gsocket->flags |= flags;
+
+    if (opts) {
+        gs_socket_set_opts(gsocket, opts);
+    }
+
+    if (gs_bind(gsocket, address, backlog) < 0) {
+        gs_close(gsocket);
+        return NULL;
+    }
+
+    return gsocket;
+}
+
+/* Duplicates the shared listener so that each reactor registers its own descriptor. */
+static struct gs_socket_t * gs_server_share(struct gs_socket_t *listener)
+{
+    struct gs_socket_t *gsocket = gs_socket(listener->domain);
+
+    if (!gsocket) {
+        return NULL;
+    }
+
+    gsocket->fd = dup(listener->fd);
+    gsocket->opts = listener->opts;
+    gsocket->flags |= listener->flags & GS_SOCKET_FLAG_OPTS;
+
+    if (gsocket->fd < 0) {
+        gs_close(gsocket);
+        return NULL;
+    }
+
+    return gsocket;
+}
+
+struct gs_server_t * gs_server_create(GS_SOCKET_DOMAIN_TYPE domain, const char *address, const struct gs_server_config_t *config, gs_server_handler_t handler, void *user_data)
+{
+    if (!address || !config || !handler) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if ((domain == GS_SOCKET_DOMAIN_UDP) || (domain == GS_SOCKET_DOMAIN_UNIX_DGRAM)) {
+        errno = EOPNOTSUPP;
+        return NULL;
+    }
+
+    struct gs_server_t *server = (struct gs_server_t *)malloc(sizeof(struct gs_server_t));
+
+    if (!server) {
+        return NULL;
+    }
+
+    memset(server, 0, sizeof(struct gs_server_t));
+
+    server->config = *config;
+    server->handler = handler;
+    server->user_data = user_data;
+
+    if (server->config.threads == 0) {
+        const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        server->config.threads = (cpus > 0) ? (unsigned int)cpus : 1;
+    }
+
+    if (domain != GS_SOCKET_DOMAIN_TCP) {
+        server->config.shared_listener = true;
+    }
+
+    server->reactors = (struct gs_reactor_t *)calloc(server->config.threads, sizeof(struct gs_reactor_t));
+
+    if (!server->reactors) {
+        free(server);
+        return NULL;
+    }
+
+    if (server->config.shared_listener) {
+        server->listener = gs_server_listen(domain, address, server->config.backlog, 0, config->socket_opts);
+
+        if (!server->listener) {
+            gs_server_destroy(server);
+            return NULL;
+        }
+    }
+
+    for (unsigned int index = 0; index < server->config.threads; ++index) {
+        struct gs_reactor_t *reactor = server->reactors + index;
+
+        reactor->server = server;
+        reactor->index = index;
+        reactor->loop = gs_loop_create();
+        server->reactors_size = index + 1;
+
+        gs_timer_init(&reactor->retry, gs_server_retry, reactor);
+
+        if (!reactor->loop) {
+            gs_server_destroy(server);
+            return NULL;
+        }
+
+        unsigned int events = GS_LOOP_EVENT_READABLE;
+
+        if (server->config.shared_listener) {
+            reactor->listener = gs_server_share(server->listener);
+            events |= GS_LOOP_FLAG_EXCLUSIVE;
+        }
+        else {
+            reactor->listener = gs_server_listen(domain, address, server->config.backlog, GS_SOCKET_FLAG_REUSEPORT, config->socket_opts);
+        }
+
+        if (!reactor->listener || (gs_loop_add(reactor->loop, reactor->listener, events, gs_server_accept, reactor) < 0)) {
+            gs_server_destroy(server);
+            return NULL;
+        }
+    }
+
+    return server;
+}
+
+int gs_server_start(struct gs_server_t *server)
+{
+    const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    for (unsigned int index = 0; index < server->reactors_size; ++index) {
+        struct gs_reactor_t *reactor = server->reactors + index;
+
+        if (reactor->running) {
+            continue;
+        }
+
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+
+        if (server->config.pin_cpu && (cpus > 0)) {
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            CPU_SET(index % cpus, &cpuset);
+            pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpuset);
+        }
+
+        const int result = pthread_create(&reactor->thread, &attr, gs_reactor_routine, reactor);
+
+        pthread_attr_destroy(&attr);
+
+        if (result != 0) {
+            gs_server_stop(server);
+            errno = result;
+            return -1;
+        }
+
+        reactor->running = true;
+    }
+
+    return 0;
+}
+
+void gs_server_stop(struct gs_server_t *server)
+{
+    for (unsigned int index = 0; index < server->reactors_size; ++index) {
+        if (server->reactors[index].running) {
+            gs_loop_stop(server->reactors[index].loop);
+        }
+    }
+
+    for (unsigned int index = 0; index < server->reactors_size; ++index) {
+        if (server->reactors[index].running) {
+            pthread_join(server->reactors[index].thread, NULL);
+            server->reactors[index].running = false;
+        }
+    }
+}
+
+void gs_server_destroy(struct gs_server_t *server)
+{
+    if (!server) {
+        return;
+    }
+
+    gs_server_stop(server);
+
+    for (unsigned int index = 0; index < server->reactors_size; ++index) {
+        struct gs_reactor_t *reactor = server->reactors + index;
+
+        if (reactor->loop) {
+            gs_timer_stop(reactor->loop, &reactor->retry);
+        }
+
+        if (reactor->listener) {
+            gs_close(reactor->listener);
+        }
+
+        gs_loop_destroy(reactor->loop);
+    }
+
+    if (server->listener) {
+        gs_close(server->listener);
+    }
+
+    free(server->reactors);
+    free(server);
+}
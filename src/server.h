@@ -0,0 +1,50 @@
+#ifndef GS_SERVER_H_
+#define GS_SERVER_H_
+
+#include <stdbool.h>
+
+#include "domain.h"
+#include "loop.h"
+#include "options.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct gs_server_t;
+
+struct gs_server_config_t
+{
+    /* Number of reactor threads, 0 for one per online CPU. */
+    unsigned int threads;
+    int backlog;
+
+    /* Pin reactor N to CPU N modulo the number of online CPUs. */
+    bool pin_cpu;
+
+    /* Poll a single listener from every reactor with GS_LOOP_FLAG_EXCLUSIVE
+     * instead of binding one SO_REUSEPORT listener per reactor. Always used
+     * for the UNIX domain. */
+    bool shared_listener;
+
+    /* Optional tuning for the listeners, inherited by every accepted client. */
+    const struct gs_socket_opts_t *socket_opts;
+};
+
+/* Called on the reactor thread that accepted the client, usually to gs_loop_add() it to the loop. */
+typedef void (*gs_server_handler_t)(struct gs_loop_t *loop, struct gs_socket_t *client, void *user_data);
+
+struct gs_server_t * gs_server_create(GS_SOCKET_DOMAIN_TYPE domain, const char *address, const struct gs_server_config_t *config, gs_server_handler_t handler, void *user_data);
+
+int gs_server_start(struct gs_server_t *server);
+
+/* Stops and joins all reactors. */
+void gs_server_stop(struct gs_server_t *server);
+
+void gs_server_destroy(struct gs_server_t *server);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* GS_SERVER_H_ */
@@ -0,0 +1,569 @@
+#include "shm.h"
+#include "socket.h"
+#include "unix_socket.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#define GS_CACHELINE_SIZE 64
+
+#define GS_SHM_MAGIC 0x67736d31
+#define GS_SHM_HEADER_SIZE 4096
+#define GS_SHM_MIN_SIZE 4096
+#define GS_SHM_MAX_SIZE (1U << 30)
+
+/* The rings are laid out once, neither side may resize the memfd afterwards. */
+#define GS_SHM_SEALS (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)
+
+/* Polls of the ring a blocking call makes before sleeping, a few microseconds; never on a single CPU. */
+#define GS_SHM_SPIN_COUNT 4096
+
+/* One direction, positions only ever grow and are masked into the data area. */
+struct gs_shm_ring_t
+{
+    unsigned long long tail;
+    unsigned int writer_waiting;
+    char padding0[GS_CACHELINE_SIZE - sizeof(unsigned long long) - sizeof(unsigned int)];
+
+    unsigned long long head;
+    unsigned int reader_waiting;
+    char padding1[GS_CACHELINE_SIZE - sizeof(unsigned long long) - sizeof(unsigned int)];
+};
+
+/* Start of the shared mapping, followed by the data of rings[0] and rings[1]. */
+struct gs_shm_header_t
+{
+    unsigned int magic;
+    unsigned int size;
+
+    /* Set by each side when it closes, index 0 is the connecting client. */
+    unsigned int closed[2];
+    char padding[GS_CACHELINE_SIZE - 4 * sizeof(unsigned int)];
+
+    /* rings[0] carries the client's data, rings[1] the server's. */
+    struct gs_shm_ring_t rings[2];
+};
+
+struct gs_shm_t
+{
+    struct gs_shm_header_t *header;
+    size_t length;
+    unsigned int side;
+    unsigned int mask;
+    unsigned int spins;
+
+    struct gs_shm_ring_t *tx;
+    struct gs_shm_ring_t *rx;
+    unsigned char *tx_data;
+    unsigned char *rx_data;
+};
+
+/* `size` is the validated ring size, the copy in the shared header stays writable by the peer. */
+static struct gs_shm_t * gs_shm_create(struct gs_shm_header_t *header, size_t length, unsigned int side, unsigned int size)
+{
+    struct gs_shm_t *shm = (struct gs_shm_t *)calloc(1, sizeof(struct gs_shm_t));
+
+    if (!shm) {
+        return NULL;
+    }
+
+    unsigned char *data = (unsigned char *)header + GS_SHM_HEADER_SIZE;
+
+    shm->header = header;
+    shm->length = length;
+    shm->side = side;
+    shm->mask = size - 1;
+    shm->spins = (sysconf(_SC_NPROCESSORS_ONLN) > 1) ? GS_SHM_SPIN_COUNT : 0;
+    shm->tx = &header->rings[side];
+    shm->rx = &header->rings[!side];
+    shm->tx_data = data + (size_t)side * size;
+    shm->rx_data = data + (size_t)!side * size;
+
+    return shm;
+}
+
+static int gs_shm_poll(int fd, int timeout)
+{
+    struct pollfd pollfd;
+    memset(&pollfd, 0, sizeof(struct pollfd));
+    pollfd.fd = fd;
+    pollfd.events = POLLIN;
+
+    int result = 0;
+
+    do {
+        result = poll(&pollfd, 1, timeout);
+    } while ((result < 0) && (errno == EINTR));
+
+    if (result == 0) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+
+    return (result < 0) ? -1 : 0;
+}
+
+int gs_shm_offer(struct gs_socket_t *gsocket, int fd)
+{
+    const size_t length = GS_SHM_HEADER_SIZE + 2 * (size_t)gsocket->shm_size;
+
+    const int memfd = memfd_create("gs_shm", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+
+    if (memfd < 0) {
+        return -1;
+    }
+
+    if ((ftruncate(memfd, (off_t)length) < 0) || (fcntl(memfd, F_ADD_SEALS, GS_SHM_SEALS) < 0)) {
+        close(memfd);
+        return -1;
+    }
+
+    void *mapping = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+
+    if (mapping == MAP_FAILED) {
+        close(memfd);
+        return -1;
+    }
+
+    struct gs_shm_header_t *header = (struct gs_shm_header_t *)mapping;
+    header->magic = GS_SHM_MAGIC;
+    header->size = gsocket->shm_size;
+
+    struct gs_shm_t *shm = gs_shm_create(header, length, 0, gsocket->shm_size);
+
+    const unsigned int magic = GS_SHM_MAGIC;
+    const int sent = (shm && (gs_unix_send_fds(fd, &magic, sizeof(magic), &memfd, 1, MSG_NOSIGNAL) == (int)sizeof(magic))) ? 0 : -1;
+    int error = errno;
+
+    close(memfd);
+
+    /* The server answers with the magic once it mapped the rings. */
+    if (sent == 0) {
+        unsigned int ack = 0;
+
+        if (gs_shm_poll(fd, GS_SHM_HANDSHAKE_TIMEOUT) < 0) {
+            error = errno;
+        }
+        else if ((recv(fd, &ack, sizeof(ack), MSG_WAITALL) == (ssize_t)sizeof(ack)) && (ack == GS_SHM_MAGIC)) {
+            gsocket->shm = shm;
+            return 0;
+        }
+        else {
+            error = EPROTO;
+        }
+    }
+
+    free(shm);
+    munmap(mapping, length);
+
+    errno = error;
+    return -1;
+}
+
+/* Gives up on a client whose handshake failed, it sees the connection close. */
+static int gs_shm_reject(struct gs_socket_t *client)
+{
+    const int error = errno;
+
+    client->flags &= ~GS_SOCKET_FLAG_SHM_PENDING;
+    shutdown(client->fd, SHUT_RDWR);
+
+    errno = error;
+    return -1;
+}
+
+int gs_shm_attach(struct gs_socket_t *client, int flags)
+{
+    const bool block = !((flags & MSG_DONTWAIT) || (client->flags & GS_SOCKET_FLAG_NONBLOCK));
+
+    if (block && (gs_shm_poll(client->fd, GS_SHM_HANDSHAKE_TIMEOUT) < 0)) {
+        return gs_shm_reject(client);
+    }
+
+    unsigned int magic = 0;
+    unsigned int count = 1;
+    int memfd = -1;
+
+    const int bytes = gs_unix_recv_fds(client->fd, &magic, sizeof(magic), &memfd, &count, NULL, block ? MSG_WAITALL : MSG_DONTWAIT);
+
+    if ((bytes < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+        return -1;
+    }
+
+    if ((bytes != (int)sizeof(magic)) || (magic != GS_SHM_MAGIC) || (count != 1)) {
+        if ((bytes >= 0) && (count == 1)) {
+            close(memfd);
+        }
+
+        if (bytes >= 0) {
+            errno = EPROTO;
+        }
+
+        return gs_shm_reject(client);
+    }
+
+    /* Unsealed, the peer could truncate the file under our mapping and fault us. */
+    const int seals = fcntl(memfd, F_GET_SEALS);
+    struct stat status;
+
+    if ((seals < 0) || ((seals & GS_SHM_SEALS) != GS_SHM_SEALS) ||
+        (fstat(memfd, &status) < 0) || (status.st_size < GS_SHM_HEADER_SIZE + 2 * GS_SHM_MIN_SIZE)) {
+        close(memfd);
+        errno = EPROTO;
+        return gs_shm_reject(client);
+    }
+
+    const size_t length = (size_t)status.st_size;
+    void *mapping = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+
+    close(memfd);
+
+    if (mapping == MAP_FAILED) {
+        return gs_shm_reject(client);
+    }
+
+    const struct gs_shm_header_t *header = (const struct gs_shm_header_t *)mapping;
+    const unsigned int size = header->size;
+
+    /* Never trust the peer's layout further than the mapping goes. */
+    if ((header->magic != GS_SHM_MAGIC) || (size & (size - 1)) || (size < GS_SHM_MIN_SIZE) ||
+        (GS_SHM_HEADER_SIZE + 2 * (size_t)size != length)) {
+        munmap(mapping, length);
+        errno = EPROTO;
+        return gs_shm_reject(client);
+    }
+
+    struct gs_shm_t *shm = gs_shm_create((struct gs_shm_header_t *)mapping, length, 1, size);
+    const unsigned int ack = GS_SHM_MAGIC;
+
+    if (!shm || (send(client->fd, &ack, sizeof(ack), MSG_NOSIGNAL) != (ssize_t)sizeof(ack))) {
+        const int error = errno;
+
+        free(shm);
+        munmap(mapping, length);
+
+        errno = error;
+        return gs_shm_reject(client);
+    }
+
+    client->shm = shm;
+    client->flags &= ~GS_SOCKET_FLAG_SHM_PENDING;
+
+    return 0;
+}
+
+void gs_shm_destroy(struct gs_shm_t *shm)
+{
+    if (!shm) {
+        return;
+    }
+
+    __atomic_store_n(&shm->header->closed[shm->side], 1, __ATOMIC_RELEASE);
+
+    munmap(shm->header, shm->length);
+    free(shm);
+}
+
+/* Copies `length` bytes at ring position `position` to or from the iovecs, starting `offset` bytes into them. */
+static void gs_shm_copy(unsigned char *data, unsigned int mask, unsigned long long position, const struct iovec *iov, unsigned int count, size_t offset, size_t length, bool to_ring)
+{
+    for (unsigned int index = 0; (index < count) && length; ++index) {
+        if (offset >= iov[index].iov_len) {
+            offset -= iov[index].iov_len;
+            continue;
+        }
+
+        unsigned char *buffer = (unsigned char *)iov[index].iov_base + offset;
+        size_t chunk = iov[index].iov_len - offset;
+
+        if (chunk > length) {
+            chunk = length;
+        }
+
+        offset = 0;
+        length -= chunk;
+
+        while (chunk) {
+            const size_t at = (size_t)(position & mask);
+            const size_t part = ((size_t)mask + 1 - at < chunk) ? ((size_t)mask + 1 - at) : chunk;
+
+            if (to_ring) {
+                memcpy(data + at, buffer, part);
+            }
+            else {
+                memcpy(buffer, data + at, part);
+            }
+
+            position += part;
+            buffer += part;
+            chunk -= part;
+        }
+    }
+}
+
+static size_t gs_shm_iov_length(const struct iovec *iov, unsigned int count)
+{
+    size_t length = 0;
+
+    for (unsigned int index = 0; index < count; ++index) {
+        length += iov[index].iov_len;
+    }
+
+    return (length > INT_MAX) ? INT_MAX : length;
+}
+
+/* Consumes the wakeup bytes sent by the peer. Returns 0 once the peer is gone, 1 otherwise. */
+static int gs_shm_drain(int fd)
+{
+    char tokens[64];
+
+    while (true) {
+        const ssize_t bytes = recv(fd, tokens, sizeof(tokens), MSG_DONTWAIT);
+
+        if (bytes == 0) {
+            return 0;
+        }
+
+        if (bytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return ((errno == EAGAIN) || (errno == EWOULDBLOCK)) ? 1 : 0;
+        }
+
+        if ((size_t)bytes < sizeof(tokens)) {
+            return 1;
+        }
+    }
+}
+
+/* Sends a wakeup if the other side announced that it is about to sleep on `waiting`. */
+static inline void gs_shm_notify(int fd, unsigned int *waiting)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(waiting, __ATOMIC_RELAXED) && __atomic_exchange_n(waiting, 0, __ATOMIC_ACQ_REL)) {
+        const char token = 0;
+
+        /* A full socket buffer means the peer has wakeups pending already. */
+        send(fd, &token, 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+    }
+}
+
+static inline void gs_shm_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+#endif
+}
+
+/* Spins until `position` moves away from `value`, returns false when it did not. */
+static bool gs_shm_spin(const struct gs_shm_t *shm, const unsigned long long *position, unsigned long long value)
+{
+    for (unsigned int spin = 0; spin < shm->spins; ++spin) {
+        if (__atomic_load_n(position, __ATOMIC_ACQUIRE) != value) {
+            return true;
+        }
+
+        gs_shm_relax();
+    }
+
+    return false;
+}
+
+/* Announces a sleep on `waiting`, the caller rechecks its ring afterwards. */
+static inline void gs_shm_prepare_wait(unsigned int *waiting)
+{
+    __atomic_store_n(waiting, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+int gs_shm_sendv(struct gs_socket_t *gsocket, const struct iovec *iov, unsigned int count, int flags)
+{
+    struct gs_shm_t *shm = gsocket->shm;
+    struct gs_shm_ring_t *ring = shm->tx;
+
+    const bool block = !((flags & MSG_DONTWAIT) || (gsocket->flags & GS_SOCKET_FLAG_NONBLOCK));
+    const size_t length = gs_shm_iov_length(iov, count);
+    const unsigned long long size = (unsigned long long)shm->mask + 1;
+
+    unsigned long long tail = ring->tail;
+    size_t sent = 0;
+
+    while (sent < length) {
+        if (__atomic_load_n(&shm->header->closed[!shm->side], __ATOMIC_ACQUIRE)) {
+            if (sent) {
+                break;
+            }
+
+            errno = EPIPE;
+            return -1;
+        }
+
+        const unsigned long long head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        const unsigned long long space = size - (tail - head);
+
+        if (space) {
+            const size_t chunk = (space < length - sent) ? (size_t)space : (length - sent);
+
+            gs_shm_copy(shm->tx_data, shm->mask, tail, iov, count, sent, chunk, true);
+
+            tail += chunk;
+            sent += chunk;
+
+            __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+            gs_shm_notify(gsocket->fd, &ring->reader_waiting);
+
+            if (!block) {
+                break;
+            }
+
+            continue;
+        }
+
+        if (block && gs_shm_spin(shm, &ring->head, head)) {
+            continue;
+        }
+
+        /* Unread wakeups could fill the socket, and a full one no longer wakes a loop. */
+        if (!block && !gs_shm_drain(gsocket->fd)) {
+            if (sent) {
+                break;
+            }
+
+            errno = EPIPE;
+            return -1;
+        }
+
+        gs_shm_prepare_wait(&ring->writer_waiting);
+
+        if (__atomic_load_n(&ring->head, __ATOMIC_RELAXED) != head) {
+            continue;
+        }
+
+        if (!block) {
+            if (sent) {
+                break;
+            }
+
+            errno = EAGAIN;
+            return -1;
+        }
+
+        if ((gs_shm_poll(gsocket->fd, -1) < 0) || !gs_shm_drain(gsocket->fd)) {
+            if (sent) {
+                break;
+            }
+
+            errno = EPIPE;
+            return -1;
+        }
+    }
+
+    return (int)sent;
+}
+
+int gs_shm_recvv(struct gs_socket_t *gsocket, const struct iovec *iov, unsigned int count, int flags)
+{
+    struct gs_shm_t *shm = gsocket->shm;
+    struct gs_shm_ring_t *ring = shm->rx;
+
+    const bool block = !((flags & MSG_DONTWAIT) || (gsocket->flags & GS_SOCKET_FLAG_NONBLOCK));
+    const size_t length = gs_shm_iov_length(iov, count);
+    const unsigned long long head = ring->head;
+
+    bool eof = false;
+
+    if (!length) {
+        return 0;
+    }
+
+    while (true) {
+        /* The peer's last bytes are published before its closed flag. */
+        eof = eof || __atomic_load_n(&shm->header->closed[!shm->side], __ATOMIC_ACQUIRE);
+
+        const unsigned long long tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+        if (tail != head) {
+            const size_t chunk = (tail - head < length) ? (size_t)(tail - head) : length;
+
+            gs_shm_copy(shm->rx_data, shm->mask, head, iov, count, 0, chunk, false);
+
+            if (!(flags & MSG_PEEK)) {
+                __atomic_store_n(&ring->head, head + chunk, __ATOMIC_RELEASE);
+                gs_shm_notify(gsocket->fd, &ring->writer_waiting);
+            }
+
+            return (int)chunk;
+        }
+
+        if (eof) {
+            return 0;
+        }
+
+        if (block && gs_shm_spin(shm, &ring->tail, head)) {
+            continue;
+        }
+
+        /* Stale wakeups would keep the socket readable for a loop. */
+        if (!gs_shm_drain(gsocket->fd)) {
+            eof = true;
+            continue;
+        }
+
+        gs_shm_prepare_wait(&ring->reader_waiting);
+
+        if (__atomic_load_n(&ring->tail, __ATOMIC_RELAXED) != head) {
+            continue;
+        }
+
+        if (!block) {
+            errno = EAGAIN;
+            return -1;
+        }
+
+        if (gs_shm_poll(gsocket->fd, -1) < 0) {
+            return -1;
+        }
+    }
+}
+
+int gs_shm_enable(struct gs_socket_t *gsocket, unsigned int size)
+{
+    if (gsocket->domain != GS_SOCKET_DOMAIN_UNIX) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    if ((gsocket->fd >= 0) || (size > GS_SHM_MAX_SIZE)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    unsigned int rounded = GS_SHM_MIN_SIZE;
+
+    while (rounded < (size ? size : GS_SHM_DEFAULT_SIZE)) {
+        rounded <<= 1;
+    }
+
+    gsocket->shm_size = rounded;
+    gsocket->flags |= GS_SOCKET_FLAG_SHM;
+
+    return 0;
+}
+
+bool gs_shm_active(const struct gs_socket_t *gsocket)
+{
+    return gsocket->shm != NULL;
+}
@@ -0,0 +1,52 @@
+#ifndef GS_SHM_H_
+#define GS_SHM_H_
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct gs_socket_t;
+
+/* Bytes in each direction when gs_shm_enable() is given 0. */
+#define GS_SHM_DEFAULT_SIZE (1U << 20)
+
+/* How long, in milliseconds, either side waits for the other during the handshake. */
+#define GS_SHM_HANDSHAKE_TIMEOUT 5000
+
+/**
+ * Moves the data of a GS_SOCKET_DOMAIN_UNIX connection through two ring
+ * buffers in memory shared with the peer instead of the kernel socket
+ * buffers. Call it on a client before gs_connect(), or on a listener
+ * before gs_bind(); both ends have to enable it. The client offers the
+ * rings (`size` bytes per direction, rounded up to a power of two) right
+ * after connecting, and gs_connect() returns once the server mapped them.
+ *
+ * Accepting never waits for the offer: the server maps the rings on its
+ * first gs_send()/gs_recv() on the client, which must come within
+ * GS_SHM_HANDSHAKE_TIMEOUT of the connect. Blocking, that call waits for
+ * the offer; non-blocking, it fails with EAGAIN until the offer made the
+ * socket readable. A failed handshake shuts the connection down, and
+ * gs_shm_active() only turns true once it is done.
+ *
+ * gs_send()/gs_recv() and their vectored forms then only enter the kernel
+ * to wake a peer that is waiting, and the socket carries nothing but
+ * those wakeups, so it still works with gs_loop. A non-blocking writer
+ * that got EAGAIN is woken by readability, not writability: wait for
+ * GS_LOOP_EVENT_READABLE (a write queue in a loop already does). A ring is
+ * single-producer and single-consumer: use a connection from one thread at
+ * a time.
+ * Non-blocking connects, batches, gs_sendfile(), gs_splice() and the
+ * io_uring sends and receives fail with EOPNOTSUPP on such connections.
+ */
+int gs_shm_enable(struct gs_socket_t *gsocket, unsigned int size);
+
+/* Whether the connection negotiated the shared rings. */
+bool gs_shm_active(const struct gs_socket_t *gsocket);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* GS_SHM_H_ */
@@ -1,9 +1,11 @@
 #include "socket.h"
 #include "unix_socket.h"
 #include "tcp_socket.h"
+#include "udp_socket.h"
 
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 
 struct gs_socket_t * gs_socket_create(GS_SOCKET_DOMAIN_TYPE domain)
 {
@@ -16,6 +18,15 @@ struct gs_socket_t * gs_socket_create(GS_SOCKET_DOMAIN_TYPE domain)
         case GS_SOCKET_DOMAIN_TCP:
             base = gs_tcp_socket_base();
             break;
+        case GS_SOCKET_DOMAIN_UDP:
+            base = gs_udp_socket_base();
+            break;
+        case GS_SOCKET_DOMAIN_UNIX_DGRAM:
+            base = gs_unix_dgram_socket_base();
+            break;
+        case GS_SOCKET_DOMAIN_UNIX_SEQPACKET:
+            base = gs_unix_seqpacket_socket_base();
+            break;
         default:
             return NULL;
     }
@@ -24,7 +35,7 @@ struct gs_socket_t * gs_socket_create(GS_SOCKET_DOMAIN_TYPE domain)
         return NULL;
     }
 
-    struct gs_socket_t *gsocket = (struct gs_socket_t *)malloc(sizeof(struct gs_socket_t));
+    struct gs_socket_t *gsocket = gs_socket_pool_alloc();
 
     if (gsocket) {
         memset(gsocket, 0, sizeof(struct gs_socket_t));
@@ -38,5 +49,36 @@ struct gs_socket_t * gs_socket_create(GS_SOCKET_DOMAIN_TYPE domain)
 
 void gs_socket_destroy(struct gs_socket_t *gsocket)
 {
-    free(gsocket);
+    gs_socket_pool_free(gsocket);
+}
+
+int gs_socket_accept4(struct gs_socket_t *gsocket, struct sockaddr *address, socklen_t *length, int flags, struct gs_socket_t *client)
+{
+    const int client_fd = accept4(gsocket->fd, address, length, flags);
+
+    if (client_fd < 0) {
+        return -1;
+    }
+
+    client->fd = client_fd;
+
+    if (flags & SOCK_NONBLOCK) {
+        client->flags |= GS_SOCKET_FLAG_NONBLOCK;
+    }
+
+    return 0;
+}
+
+int gs_socket_set_address(struct gs_socket_t *gsocket, const char *address)
+{
+    const size_t length = strlen(address);
+
+    if (length >= sizeof(gsocket->address)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    memcpy(gsocket->address, address, length + 1);
+
+    return 0;
 }
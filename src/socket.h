@@ -1,19 +1,113 @@
 #ifndef GS_SOCKET_H_
 #define GS_SOCKET_H_
 
+#include <stdbool.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/types.h>
+#include <time.h>
+
 #include "domain.h"
+#include "fds.h"
+#include "loop.h"
+#include "options.h"
+#include "stats.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#define GS_SOCKET_ADDRESS_SIZE 128
+
+struct gs_msg_buffer_t;
+struct gs_write_queue_t;
+struct gs_splice_pipe_t;
+struct gs_shm_t;
+
+enum
+{
+    GS_SOCKET_FLAG_REUSEPORT = 0x01,
+    GS_SOCKET_FLAG_NONBLOCK = 0x02,
+    GS_SOCKET_FLAG_OPTS = 0x04,
+    GS_SOCKET_FLAG_SHM = 0x08,
+    GS_SOCKET_FLAG_HANDOFF = 0x10,
+    GS_SOCKET_FLAG_AUTOBIND = 0x20,
+
+    /* Accepted by a shared-memory listener, the client's offer is not taken yet. */
+    GS_SOCKET_FLAG_SHM_PENDING = 0x40
+};
+
+/* Which subset of gs_socket_opts_t applies to a new descriptor. */
+enum
+{
+    GS_SOCKET_ROLE_LISTENER,
+    GS_SOCKET_ROLE_CLIENT,
+    GS_SOCKET_ROLE_ACCEPTED,
+
+    /* A client configured after connecting, too late for connect-time options. */
+    GS_SOCKET_ROLE_CONNECTED
+};
+
+/* A parsed address, see gs_addr_resolve(). */
+struct gs_addr_t
+{
+    GS_SOCKET_DOMAIN_TYPE domain;
+    socklen_t length;
+    struct sockaddr_storage storage;
+
+    /* The text it was parsed from, recorded as the bound address. */
+    char text[GS_SOCKET_ADDRESS_SIZE];
+};
+
 struct gs_socket_t
 {
     const struct gs_socket_base_t *base;
     GS_SOCKET_DOMAIN_TYPE domain;
 
     int fd;
-    char *address;
+    char address[GS_SOCKET_ADDRESS_SIZE];
+    unsigned int flags;
+
+    struct gs_loop_t *loop;
+    gs_loop_handler_t handler;
+    void *user_data;
+    unsigned int events;
+
+    /**
+     * Connect deadline and gs_loop_set_timeouts() in monotonic milliseconds.
+     * One wheel timer covers them all, it is only moved when it fires early.
+     */
+    struct gs_timer_t timer;
+    unsigned long long connect_deadline;
+    unsigned long long last_read;
+    unsigned long long last_write;
+    unsigned int read_timeout;
+    unsigned int write_timeout;
+    unsigned int idle_timeout;
+    unsigned int timeout_flags;
+
+    /* Framing receive buffer, allocated on first use by gs_msg_recv(). */
+    struct gs_msg_buffer_t *rx;
+
+    /* Output queue, see gs_write_queue_enable(). */
+    struct gs_write_queue_t *wq;
+
+    /* Pipe used by gs_splice() when this socket is the destination. */
+    struct gs_splice_pipe_t *pipe;
+
+    /* Number the kernel gives to the next MSG_ZEROCOPY send. */
+    unsigned int zerocopy_next;
+
+    /* Valid with GS_SOCKET_FLAG_OPTS. */
+    struct gs_socket_opts_t opts;
+
+    /* Ring size requested by gs_shm_enable(), and the rings once negotiated. */
+    unsigned int shm_size;
+    struct gs_shm_t *shm;
+
+#ifdef GS_STATS
+    struct gs_stats_t stats;
+#endif
 };
 
 struct gs_socket_base_t
@@ -22,21 +116,143 @@ struct gs_socket_base_t
 
     int (*close)(struct gs_socket_t *gsocket);
 
-    int (*bind)(struct gs_socket_t *gsocket, const char *address, int backlog);
+    int (*bind)(struct gs_socket_t *gsocket, const struct gs_addr_t *address, int backlog);
 
+    /* accept and accept4 are NULL for connectionless domains. */
     int (*accept)(struct gs_socket_t *gsocket, char *address, unsigned int length, struct gs_socket_t *client);
 
-    int (*connect)(struct gs_socket_t *gsocket, const char *address);
+    /* accept4() a single client without formatting its address, `flags` are SOCK_NONBLOCK/SOCK_CLOEXEC. */
+    int (*accept4)(struct gs_socket_t *gsocket, struct sockaddr *address, socklen_t *length, int flags, struct gs_socket_t *client);
+
+    int (*connect)(struct gs_socket_t *gsocket, const struct gs_addr_t *address);
 
     int (*send)(struct gs_socket_t *gsocket, const void *data, unsigned int length, int flags);
 
     int (*recv)(struct gs_socket_t *gsocket, void *data, unsigned int length, int flags);
+
+    int (*sendv)(struct gs_socket_t *gsocket, const struct iovec *iov, unsigned int count, int flags);
+
+    int (*recvv)(struct gs_socket_t *gsocket, const struct iovec *iov, unsigned int count, int flags);
+
+    int (*send_batch)(struct gs_socket_t *gsocket, struct mmsghdr *messages, unsigned int count, int flags);
+
+    int (*recv_batch)(struct gs_socket_t *gsocket, struct mmsghdr *messages, unsigned int count, int flags);
+
+    /* Optional, NULL when the domain cannot transmit files. */
+    int (*sendfile)(struct gs_socket_t *gsocket, int file_fd, off_t *offset, size_t count);
+
+    /* Descriptor passing, NULL outside the UNIX domains. */
+    int (*send_fds)(struct gs_socket_t *gsocket, const void *data, unsigned int length, const int *fds, unsigned int count, int flags);
+
+    int (*recv_fds)(struct gs_socket_t *gsocket, void *data, unsigned int length, int *fds, unsigned int *count, struct gs_cred_t *cred, int flags);
 };
 
+enum
+{
+    GS_STATS_OP_SEND,
+    GS_STATS_OP_RECV,
+    GS_STATS_OP_ACCEPT,
+    GS_STATS_OP_CONNECT
+};
+
+#ifdef GS_STATS
+
+static inline unsigned long long gs_stats_clock(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+#endif
+}
+
+/* Counts one call for the calling thread and the socket, `result` being bytes or clients, or -1 with errno set. */
+void gs_stats_record(struct gs_socket_t *gsocket, int op, long result, size_t requested, unsigned long long cycles);
+
+/* Bytes a vectored call asked for, only evaluated when statistics are compiled in. */
+static inline size_t gs_iov_length(const struct iovec *iov, unsigned int count)
+{
+    size_t length = 0;
+
+    for (unsigned int index = 0; index < count; ++index) {
+        length += iov[index].iov_len;
+    }
+
+    return length;
+}
+
+#define GS_STATS_CLOCK() gs_stats_clock()
+#define GS_STATS_RECORD(gsocket, op, result, requested, start) gs_stats_record((gsocket), (op), (result), (requested), gs_stats_clock() - (start))
+
+#else
+
+#define GS_STATS_CLOCK() 0ULL
+#define GS_STATS_RECORD(gsocket, op, result, requested, start) ((void)(start))
+
+#endif
+
+/* Data goes through shared-memory rings, negotiated or still pending, never straight to the descriptor. */
+static inline bool gs_socket_shm(const struct gs_socket_t *gsocket)
+{
+    return gsocket->shm || (gsocket->flags & GS_SOCKET_FLAG_SHM_PENDING);
+}
+
+/* Event telling a socket it can send again, shared-memory rings signal freed space as readability. */
+static inline unsigned int gs_socket_output_event(const struct gs_socket_t *gsocket)
+{
+    return gs_socket_shm(gsocket) ? GS_LOOP_EVENT_READABLE : GS_LOOP_EVENT_WRITABLE;
+}
+
 struct gs_socket_t * gs_socket_create(GS_SOCKET_DOMAIN_TYPE domain);
 
 void gs_socket_destroy(struct gs_socket_t *gsocket);
 
+/* Stores the bound address without allocating, fails with ENAMETOOLONG if it does not fit. */
+int gs_socket_set_address(struct gs_socket_t *gsocket, const char *address);
+
+/* accept4() shared by the connection-oriented domains, fills in the client's descriptor and flags. */
+int gs_socket_accept4(struct gs_socket_t *gsocket, struct sockaddr *address, socklen_t *length, int flags, struct gs_socket_t *client);
+
+/* Applies the stored gs_socket_opts_t to a descriptor the domain just created. */
+int gs_socket_apply_opts(const struct gs_socket_t *gsocket, int fd, int role);
+
+/* Copies the listener's options to an accepted client and applies them. */
+int gs_socket_inherit_opts(struct gs_socket_t *client, const struct gs_socket_t *listener);
+
+/* Fills a caller-provided gs_addr_t, the allocation-free core of gs_addr_resolve(). */
+int gs_addr_parse(struct gs_addr_t *address, GS_SOCKET_DOMAIN_TYPE domain, const char *text);
+
+void gs_msg_buffer_destroy(struct gs_msg_buffer_t *buffer);
+
+void gs_write_queue_destroy(struct gs_write_queue_t *queue);
+
+void gs_splice_pipe_destroy(struct gs_splice_pipe_t *pipe);
+
+/* Client side of the gs_shm_enable() handshake on a freshly connected descriptor. */
+int gs_shm_offer(struct gs_socket_t *gsocket, int fd);
+
+/**
+ * Server side of the handshake, maps the rings the client offered. Called
+ * by the first data call on a GS_SOCKET_FLAG_SHM_PENDING client, fails with
+ * EAGAIN while a non-blocking one has no offer yet and shuts the connection
+ * down on any other error.
+ */
+int gs_shm_attach(struct gs_socket_t *client, int flags);
+
+int gs_shm_sendv(struct gs_socket_t *gsocket, const struct iovec *iov, unsigned int count, int flags);
+
+int gs_shm_recvv(struct gs_socket_t *gsocket, const struct iovec *iov, unsigned int count, int flags);
+
+/* Tells the peer this side is gone and unmaps the rings. */
+void gs_shm_destroy(struct gs_shm_t *shm);
+
+struct gs_socket_t * gs_socket_pool_alloc(void);
+
+void gs_socket_pool_free(struct gs_socket_t *gsocket);
+
 #ifdef __cplusplus
 }
 #endif
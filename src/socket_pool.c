@@ -0,0 +1,222 @@
+#include "socket_pool.h"
+#include "socket.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+/* Sockets per malloc() when the pool runs dry. */
+#define GS_SOCKET_POOL_SLAB_SIZE 64
+
+/* Sockets moved between a thread cache and the global list at once. */
+#define GS_SOCKET_POOL_BATCH_SIZE 32
+
+/* Upper bound of a thread cache before half of it is given back. */
+#define GS_SOCKET_POOL_CACHE_SIZE 128
+
+struct gs_socket_node_t
+{
+    struct gs_socket_node_t *next;
+};
+
+struct gs_socket_cache_t
+{
+    struct gs_socket_node_t *head;
+    unsigned int size;
+    int registered;
+};
+
+static pthread_mutex_t gs_socket_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct gs_socket_node_t *gs_socket_pool_head = NULL;
+
+static pthread_once_t gs_socket_pool_once = PTHREAD_ONCE_INIT;
+static pthread_key_t gs_socket_pool_key;
+
+static __thread struct gs_socket_cache_t gs_socket_cache = {NULL, 0, 0};
+
+static unsigned long gs_socket_pool_allocations = 0;
+static unsigned long gs_socket_pool_misses = 0;
+static unsigned long gs_socket_pool_slabs = 0;
+static unsigned long gs_socket_pool_arena_objects = 0;
+
+/* Moves `count` sockets from the thread cache back to the global list. */
+static void gs_socket_cache_flush(struct gs_socket_cache_t *cache, unsigned int count)
+{
+    if (!count || !cache->head) {
+        return;
+    }
+
+    struct gs_socket_node_t *first = cache->head;
+    struct gs_socket_node_t *last = first;
+    unsigned int moved = 1;
+
+    while ((moved < count) && last->next) {
+        last = last->next;
+        ++moved;
+    }
+
+    cache->head = last->next;
+    cache->size -= moved;
+
+    pthread_mutex_lock(&gs_socket_pool_mutex);
+    last->next = gs_socket_pool_head;
+    gs_socket_pool_head = first;
+    pthread_mutex_unlock(&gs_socket_pool_mutex);
+}
+
+static void gs_socket_cache_destructor(void *user_data)
+{
+    struct gs_socket_cache_t *cache = (struct gs_socket_cache_t *)user_data;
+
+    gs_socket_cache_flush(cache, cache->size);
+}
+
+static void gs_socket_pool_init(void)
+{
+    pthread_key_create(&gs_socket_pool_key, gs_socket_cache_destructor);
+}
+
+/* Makes sure the thread cache is given back when the thread exits. */
+static void gs_socket_cache_register(struct gs_socket_cache_t *cache)
+{
+    if (!cache->registered) {
+        pthread_once(&gs_socket_pool_once, gs_socket_pool_init);
+        pthread_setspecific(gs_socket_pool_key, cache);
+        cache->registered = 1;
+    }
+}
+
+/* Refills an empty thread cache from the global list, allocating a new slab if needed. */
+static int gs_socket_cache_refill(struct gs_socket_cache_t *cache)
+{
+    gs_socket_cache_register(cache);
+
+    pthread_mutex_lock(&gs_socket_pool_mutex);
+
+    unsigned int count = 0;
+
+    while (gs_socket_pool_head && (count < GS_SOCKET_POOL_BATCH_SIZE)) {
+        struct gs_socket_node_t *node = gs_socket_pool_head;
+        gs_socket_pool_head = node->next;
+
+        node->next = cache->head;
+        cache->head = node;
+        ++count;
+    }
+
+    pthread_mutex_unlock(&gs_socket_pool_mutex);
+
+    if (count) {
+        cache->size += count;
+        return 0;
+    }
+
+    char *slab = (char *)malloc(GS_SOCKET_POOL_SLAB_SIZE * sizeof(struct gs_socket_t));
+
+    if (!slab) {
+        return -1;
+    }
+
+    for (unsigned int index = 0; index < GS_SOCKET_POOL_SLAB_SIZE; ++index) {
+        struct gs_socket_node_t *node = (struct gs_socket_node_t *)(slab + index * sizeof(struct gs_socket_t));
+
+        node->next = cache->head;
+        cache->head = node;
+    }
+
+    cache->size += GS_SOCKET_POOL_SLAB_SIZE;
+
+    __atomic_fetch_add(&gs_socket_pool_misses, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&gs_socket_pool_slabs, 1, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+struct gs_socket_t * gs_socket_pool_alloc(void)
+{
+    struct gs_socket_cache_t *cache = &gs_socket_cache;
+
+    if (!cache->head && (gs_socket_cache_refill(cache) < 0)) {
+        return NULL;
+    }
+
+    struct gs_socket_node_t *node = cache->head;
+    cache->head = node->next;
+    --cache->size;
+
+    __atomic_fetch_add(&gs_socket_pool_allocations, 1, __ATOMIC_RELAXED);
+
+    return (struct gs_socket_t *)node;
+}
+
+void gs_socket_pool_free(struct gs_socket_t *gsocket)
+{
+    if (!gsocket) {
+        return;
+    }
+
+    struct gs_socket_cache_t *cache = &gs_socket_cache;
+    struct gs_socket_node_t *node = (struct gs_socket_node_t *)gsocket;
+
+    /* A thread may only ever free, e.g. a worker closing clients accepted elsewhere. */
+    gs_socket_cache_register(cache);
+
+    node->next = cache->head;
+    cache->head = node;
+    ++cache->size;
+
+    if (cache->size > GS_SOCKET_POOL_CACHE_SIZE) {
+        gs_socket_cache_flush(cache, GS_SOCKET_POOL_CACHE_SIZE / 2);
+    }
+}
+
+unsigned int gs_socket_pool_provide(void *memory, size_t size)
+{
+    const uintptr_t alignment = sizeof(void *);
+    const uintptr_t begin = ((uintptr_t)memory + alignment - 1) & ~(alignment - 1);
+    const uintptr_t end = (uintptr_t)memory + size;
+
+    if (!memory || (begin >= end)) {
+        return 0;
+    }
+
+    const unsigned int count = (unsigned int)((end - begin) / sizeof(struct gs_socket_t));
+
+    if (!count) {
+        return 0;
+    }
+
+    char *base = (char *)begin;
+
+    for (unsigned int index = 0; index + 1 < count; ++index) {
+        ((struct gs_socket_node_t *)(base + index * sizeof(struct gs_socket_t)))->next = (struct gs_socket_node_t *)(base + (index + 1) * sizeof(struct gs_socket_t));
+    }
+
+    struct gs_socket_node_t *first = (struct gs_socket_node_t *)base;
+    struct gs_socket_node_t *last = (struct gs_socket_node_t *)(base + (count - 1) * sizeof(struct gs_socket_t));
+
+    pthread_mutex_lock(&gs_socket_pool_mutex);
+    last->next = gs_socket_pool_head;
+    gs_socket_pool_head = first;
+    pthread_mutex_unlock(&gs_socket_pool_mutex);
+
+    __atomic_fetch_add(&gs_socket_pool_arena_objects, count, __ATOMIC_RELAXED);
+
+    return count;
+}
+
+void gs_socket_pool_stats(struct gs_socket_pool_stats_t *stats)
+{
+    if (!stats) {
+        return;
+    }
+
+    const unsigned long allocations = __atomic_load_n(&gs_socket_pool_allocations, __ATOMIC_RELAXED);
+    const unsigned long misses = __atomic_load_n(&gs_socket_pool_misses, __ATOMIC_RELAXED);
+
+    stats->allocations = allocations;
+    stats->hits = (allocations > misses) ? (allocations - misses) : 0;
+    stats->slabs = __atomic_load_n(&gs_socket_pool_slabs, __ATOMIC_RELAXED);
+    stats->arena_objects = __atomic_load_n(&gs_socket_pool_arena_objects, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,34 @@
+#ifndef GS_SOCKET_POOL_H_
+#define GS_SOCKET_POOL_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct gs_socket_pool_stats_t
+{
+    unsigned long allocations;
+
+    /* Allocations served from a free list without calling malloc(). */
+    unsigned long hits;
+
+    unsigned long slabs;
+    unsigned long arena_objects;
+};
+
+/**
+ * Hands caller-owned memory to the socket pool. The memory has to outlive
+ * every socket created afterwards and is never released by the library.
+ * Returns the number of sockets carved out of it.
+ */
+unsigned int gs_socket_pool_provide(void *memory, size_t size);
+
+void gs_socket_pool_stats(struct gs_socket_pool_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* GS_SOCKET_POOL_H_ */
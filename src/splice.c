@@ -0,0 +1,124 @@
+#include "gs.h"
+#include "socket.h"
+
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* Bytes moved through the pipe per splice() pair. */
+#define GS_SPLICE_CHUNK_SIZE (64 * 1024)
+
+struct gs_splice_pipe_t
+{
+    int fds[2];
+
+    /* Bytes that reached the pipe but not the destination yet. */
+    size_t pending;
+};
+
+void gs_splice_pipe_destroy(struct gs_splice_pipe_t *pipe)
+{
+    if (!pipe) {
+        return;
+    }
+
+    close(pipe->fds[0]);
+    close(pipe->fds[1]);
+
+    free(pipe);
+}
+
+static struct gs_splice_pipe_t * gs_splice_pipe(struct gs_socket_t *gsocket)
+{
+    if (gsocket->pipe) {
+        return gsocket->pipe;
+    }
+
+    struct gs_splice_pipe_t *splice_pipe = (struct gs_splice_pipe_t *)calloc(1, sizeof(struct gs_splice_pipe_t));
+
+    if (!splice_pipe) {
+        return NULL;
+    }
+
+    if (pipe2(splice_pipe->fds, O_NONBLOCK | O_CLOEXEC) < 0) {
+        free(splice_pipe);
+        return NULL;
+    }
+
+    gsocket->pipe = splice_pipe;
+
+    return splice_pipe;
+}
+
+/* Moves what is buffered in the pipe to the destination socket. */
+static int gs_splice_drain(struct gs_splice_pipe_t *pipe, struct gs_socket_t *to)
+{
+    while (pipe->pending) {
+        const ssize_t bytes = splice(pipe->fds[0], NULL, to->fd, NULL, pipe->pending, SPLICE_F_MOVE | SPLICE_F_MORE);
+
+        if (bytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return -1;
+        }
+
+        pipe->pending -= bytes;
+    }
+
+    return 0;
+}
+
+long gs_splice(struct gs_socket_t *from, struct gs_socket_t *to, size_t count)
+{
+    /* Shared-memory connections carry their data outside the socket. */
+    if (gs_socket_shm(from) || gs_socket_shm(to)) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    struct gs_splice_pipe_t *pipe = gs_splice_pipe(to);
+
+    if (!pipe) {
+        return -1;
+    }
+
+    if (gs_splice_drain(pipe, to) < 0) {
+        return -1;
+    }
+
+    long forwarded = 0;
+
+    while ((size_t)forwarded < count) {
+        const size_t chunk = ((count - forwarded) < GS_SPLICE_CHUNK_SIZE) ? (count - forwarded) : GS_SPLICE_CHUNK_SIZE;
+        const ssize_t bytes = splice(from->fd, NULL, pipe->fds[1], NULL, chunk, SPLICE_F_MOVE | SPLICE_F_MORE);
+
+        if (bytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return forwarded ? forwarded : -1;
+        }
+
+        if (bytes == 0) {
+            break;
+        }
+
+        pipe->pending += bytes;
+        forwarded += bytes;
+
+        if (gs_splice_drain(pipe, to) < 0) {
+            /* The data stays in the pipe and goes out first on the next call. */
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                return forwarded;
+            }
+
+            return -1;
+        }
+    }
+
+    return forwarded;
+}
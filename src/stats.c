@@ -0,0 +1,247 @@
+#include "stats.h"
+#include "socket.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#ifdef GS_STATS
+
+#define GS_STATS_COUNTERS (sizeof(struct gs_stats_t) / sizeof(unsigned long long))
+
+/* Adds the counters of `from` to `to`, every field being an unsigned long long. */
+static void gs_stats_accumulate(struct gs_stats_t *to, const struct gs_stats_t *from)
+{
+    unsigned long long *target = (unsigned long long *)to;
+    const unsigned long long *source = (const unsigned long long *)from;
+
+    for (size_t index = 0; index < GS_STATS_COUNTERS; ++index) {
+        target[index] += __atomic_load_n(source + index, __ATOMIC_RELAXED);
+    }
+}
+
+struct gs_stats_block_t
+{
+    struct gs_stats_t counters;
+
+    struct gs_stats_block_t *prev;
+    struct gs_stats_block_t *next;
+};
+
+static pthread_once_t gs_stats_once = PTHREAD_ONCE_INIT;
+static pthread_key_t gs_stats_key;
+static pthread_mutex_t gs_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Live per-thread blocks, and the totals of the threads that exited. */
+static struct gs_stats_block_t *gs_stats_blocks = NULL;
+static struct gs_stats_t gs_stats_retired;
+
+static __thread struct gs_stats_block_t *gs_stats_block = NULL;
+
+static void gs_stats_block_destructor(void *user_data)
+{
+    struct gs_stats_block_t *block = (struct gs_stats_block_t *)user_data;
+
+    pthread_mutex_lock(&gs_stats_mutex);
+
+    gs_stats_accumulate(&gs_stats_retired, &block->counters);
+
+    if (block->prev) {
+        block->prev->next = block->next;
+    }
+    else {
+        gs_stats_blocks = block->next;
+    }
+
+    if (block->next) {
+        block->next->prev = block->prev;
+    }
+
+    pthread_mutex_unlock(&gs_stats_mutex);
+
+    free(block);
+}
+
+static void gs_stats_init(void)
+{
+    pthread_key_create(&gs_stats_key, gs_stats_block_destructor);
+}
+
+static struct gs_stats_block_t * gs_stats_local(void)
+{
+    if (gs_stats_block) {
+        return gs_stats_block;
+    }
+
+    pthread_once(&gs_stats_once, gs_stats_init);
+
+    struct gs_stats_block_t *block = (struct gs_stats_block_t *)calloc(1, sizeof(struct gs_stats_block_t));
+
+    if (!block) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&gs_stats_mutex);
+
+    block->next = gs_stats_blocks;
+
+    if (gs_stats_blocks) {
+        gs_stats_blocks->prev = block;
+    }
+
+    gs_stats_blocks = block;
+
+    pthread_mutex_unlock(&gs_stats_mutex);
+
+    pthread_setspecific(gs_stats_key, block);
+    gs_stats_block = block;
+
+    return block;
+}
+
+/* Only the owning thread writes a counter, a plain load and store keeps it free of locked instructions. */
+static inline void gs_stats_add(unsigned long long *counter, unsigned long long value)
+{
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + value, __ATOMIC_RELAXED);
+}
+
+static void gs_stats_update(struct gs_stats_t *stats, int op, long result, size_t requested, unsigned long long cycles, int error)
+{
+    const bool again = (result < 0) && ((error == EAGAIN) || (error == EWOULDBLOCK));
+
+    switch (op) {
+        case GS_STATS_OP_SEND:
+            gs_stats_add(&stats->send_calls, 1);
+            gs_stats_add(&stats->send_cycles, cycles);
+
+            if (result >= 0) {
+                gs_stats_add(&stats->bytes_sent, (unsigned long long)result);
+
+                if ((size_t)result < requested) {
+                    gs_stats_add(&stats->partial_sends, 1);
+                }
+            }
+            break;
+        case GS_STATS_OP_RECV:
+            gs_stats_add(&stats->recv_calls, 1);
+            gs_stats_add(&stats->recv_cycles, cycles);
+
+            if (result >= 0) {
+                gs_stats_add(&stats->bytes_received, (unsigned long long)result);
+            }
+            break;
+        case GS_STATS_OP_ACCEPT:
+            gs_stats_add(&stats->accept_calls, 1);
+            gs_stats_add(&stats->accept_cycles, cycles);
+
+            if (result >= 0) {
+                gs_stats_add(&stats->accepts, (unsigned long long)result);
+            }
+            else if (!again) {
+                gs_stats_add(&stats->accept_failures, 1);
+            }
+            break;
+        case GS_STATS_OP_CONNECT:
+            gs_stats_add(&stats->connects, 1);
+
+            if ((result < 0) && (error != EINPROGRESS)) {
+                gs_stats_add(&stats->connect_failures, 1);
+            }
+            return;
+        default:
+            return;
+    }
+
+    if (again) {
+        gs_stats_add(&stats->eagain, 1);
+    }
+    else if (result < 0) {
+        gs_stats_add(&stats->errors, 1);
+    }
+}
+
+void gs_stats_record(struct gs_socket_t *gsocket, int op, long result, size_t requested, unsigned long long cycles)
+{
+    const int error = errno;
+    struct gs_stats_block_t *block = gs_stats_local();
+
+    if (block) {
+        gs_stats_update(&block->counters, op, result, requested, cycles, error);
+    }
+
+    if (gsocket) {
+        gs_stats_update(&gsocket->stats, op, result, requested, cycles, error);
+    }
+
+    errno = error;
+}
+
+void gs_stats(struct gs_stats_t *stats)
+{
+    memset(stats, 0, sizeof(struct gs_stats_t));
+
+    pthread_mutex_lock(&gs_stats_mutex);
+
+    gs_stats_accumulate(stats, &gs_stats_retired);
+
+    for (const struct gs_stats_block_t *block = gs_stats_blocks; block; block = block->next) {
+        gs_stats_accumulate(stats, &block->counters);
+    }
+
+    pthread_mutex_unlock(&gs_stats_mutex);
+}
+
+void gs_socket_stats(const struct gs_socket_t *gsocket, struct gs_stats_t *stats)
+{
+    memset(stats, 0, sizeof(struct gs_stats_t));
+
+    gs_stats_accumulate(stats, &gsocket->stats);
+}
+
+#else
+
+void gs_stats(struct gs_stats_t *stats)
+{
+    memset(stats, 0, sizeof(struct gs_stats_t));
+}
+
+void gs_socket_stats(const struct gs_socket_t *gsocket, struct gs_stats_t *stats)
+{
+    (void)gsocket;
+
+    memset(stats, 0, sizeof(struct gs_stats_t));
+}
+
+#endif
+
+int gs_stats_dump(const struct gs_stats_t *stats, char *buffer, unsigned int length)
+{
+    const unsigned long long send_average = stats->send_calls ? (stats->send_cycles / stats->send_calls) : 0;
+    const unsigned long long recv_average = stats->recv_calls ? (stats->recv_cycles / stats->recv_calls) : 0;
+    const unsigned long long accept_average = stats->accept_calls ? (stats->accept_cycles / stats->accept_calls) : 0;
+
+    return snprintf(buffer, length,
+                    "send_calls %llu\n"
+                    "recv_calls %llu\n"
+                    "accept_calls %llu\n"
+                    "bytes_sent %llu\n"
+                    "bytes_received %llu\n"
+                    "partial_sends %llu\n"
+                    "eagain %llu\n"
+                    "errors %llu\n"
+                    "accepts %llu\n"
+                    "accept_failures %llu\n"
+                    "connects %llu\n"
+                    "connect_failures %llu\n"
+                    "send_cycles_avg %llu\n"
+                    "recv_cycles_avg %llu\n"
+                    "accept_cycles_avg %llu\n",
+                    stats->send_calls, stats->recv_calls, stats->accept_calls,
+                    stats->bytes_sent, stats->bytes_received, stats->partial_sends,
+                    stats->eagain, stats->errors,
+                    stats->accepts, stats->accept_failures, stats->connects, stats->connect_failures,
+                    send_average, recv_average, accept_average);
+}
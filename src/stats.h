@@ -0,0 +1,53 @@
+#ifndef GS_STATS_H_
+#define GS_STATS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct gs_socket_t;
+
+struct gs_stats_t
+{
+    unsigned long long send_calls;
+    unsigned long long recv_calls;
+    unsigned long long accept_calls;
+
+    unsigned long long bytes_sent;
+    unsigned long long bytes_received;
+
+    /* Sends that moved fewer bytes than requested. */
+    unsigned long long partial_sends;
+
+    /* Calls that failed with EAGAIN/EWOULDBLOCK, and with anything else. */
+    unsigned long long eagain;
+    unsigned long long errors;
+
+    unsigned long long accepts;
+    unsigned long long accept_failures;
+    unsigned long long connects;
+    unsigned long long connect_failures;
+
+    /* Time spent in the calls, in TSC cycles on x86 and nanoseconds elsewhere. */
+    unsigned long long send_cycles;
+    unsigned long long recv_cycles;
+    unsigned long long accept_cycles;
+};
+
+/**
+ * Sums the per-thread counters, including those of threads that exited.
+ * Everything reads zero when the library is built with GS_STATS off.
+ */
+void gs_stats(struct gs_stats_t *stats);
+
+/* Counters of a single socket; for a listener, `accepts` counts its clients. */
+void gs_socket_stats(const struct gs_socket_t *gsocket, struct gs_stats_t *stats);
+
+/* Writes one "name value" line per counter. Returns the length like snprintf(). */
+int gs_stats_dump(const struct gs_stats_t *stats, char *buffer, unsigned int length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* GS_STATS_H_ */
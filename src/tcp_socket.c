@@ -1,56 +1,21 @@
 #include "tcp_socket.h"
+#include "inet.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
 #include <sys/socket.h>
+#include <sys/sendfile.h>
 #include <sys/types.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
-struct ipv4_address_t
-{
-    char ip[16];
-    unsigned int port;
-};
-
-static inline int address_to_ipv4(const char *address, struct ipv4_address_t *ipv4)
-{
-    if (!address || !ipv4) {
-        return -1;
-    }
-
-    memset(ipv4, 0, sizeof(struct ipv4_address_t));
-
-    unsigned int ip[4] = {0};
-    unsigned int port = 0;
-    char postfix[64];
-
-    if (sscanf(address, "%u.%u.%u.%u:%u%s", ip, ip + 1, ip + 2, ip + 3, &port, postfix) != 5) {
-        return -1;
-    }
-
-    for (unsigned int index = 0; index < 4; ++index) {
-        if (ip[index] > 255) {
-            return -1;
-        }
-    }
-
-    if (port > 65536) {
-        return -1;
-    }
-
-    snprintf(ipv4->ip, sizeof(ipv4->ip), "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
-    ipv4->port = port;
-
-    return 0;
-}
-
 static int gs_tcp_socket_init(struct gs_socket_t *gsocket)
 {
     gsocket->fd = -1;
-    gsocket->address = NULL;
+    gsocket->address[0] = '\0';
 
     return 0;
 }
@@ -62,41 +27,43 @@ static int gs_tcp_socket_close(struct gs_socket_t *gsocket)
         gsocket->fd = -1;
     }
 
-    if (gsocket->address) {
-        free(gsocket->address);
-        gsocket->address = NULL;
-    }
+    gsocket->address[0] = '\0';
 
     return 0;
 }
 
-static int gs_tcp_socket_bind(struct gs_socket_t *gsocket, const char *address, int backlog)
+static int gs_tcp_socket_bind(struct gs_socket_t *gsocket, const struct gs_addr_t *address, int backlog)
 {
     if (gsocket->fd >= 0) {
         return -1;
     }
 
-    struct ipv4_address_t ip_addr;
-    memset(&ip_addr, 0, sizeof(struct ipv4_address_t));
+    int fd = socket(address->storage.ss_family, SOCK_STREAM, 0);
 
-    if (address_to_ipv4(address, &ip_addr) != 0) {
+    if (fd < 0) {
         return -1;
     }
 
-    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (gs_socket_apply_opts(gsocket, fd, GS_SOCKET_ROLE_LISTENER) < 0) {
+        close(fd);
+        return -1;
+    }
 
-    if (fd < 0) {
+    if (gs_inet_dual_stack(fd, address->storage.ss_family) < 0) {
+        close(fd);
         return -1;
     }
 
-    struct sockaddr_in socket_addr;
-    memset(&socket_addr, 0, sizeof(struct sockaddr_in));
+    if (gsocket->flags & GS_SOCKET_FLAG_REUSEPORT) {
+        const int enable = 1;
 
-    socket_addr.sin_family = AF_INET;
-    socket_addr.sin_port = htons(ip_addr.port);
-    socket_addr.sin_addr.s_addr = inet_addr(ip_addr.ip);
+        if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) < 0) {
+            close(fd);
+            return -1;
+        }
+    }
 
-    if (bind(fd, (struct sockaddr *)&socket_addr, sizeof(socket_addr)) != 0) {
+    if (bind(fd, (const struct sockaddr *)&address->storage, address->length) != 0) {
         close(fd);
         return -1;
     }
@@ -107,7 +74,7 @@ static int gs_tcp_socket_bind(struct gs_socket_t *gsocket, const char *address,
     }
 
     gsocket->fd = fd;
-    gsocket->address = strdup(address);
+    gs_socket_set_address(gsocket, address->text);
 
     return 0;
 }
@@ -117,17 +84,16 @@ static int gs_tcp_socket_accept(struct gs_socket_t *gsocket, char *address, unsi
     struct sockaddr_storage socket_storage;
     memset(&socket_storage, 0, sizeof(struct sockaddr_storage));
 
-    struct sockaddr_in *client_info = (struct sockaddr_in *)&socket_storage;
     socklen_t sockaddr_len = sizeof(struct sockaddr_storage);
 
-    const int client_fd = accept(gsocket->fd, (struct sockaddr *)client_info, &sockaddr_len);
+    const int client_fd = accept(gsocket->fd, (struct sockaddr *)&socket_storage, &sockaddr_len);
 
     if (client_fd < 0) {
         return -1;
     }
 
     if (address && length) {
-        snprintf(address, length, "%s:%u", inet_ntoa(client_info->sin_addr), ntohs(client_info->sin_port));
+        gs_inet_format((const struct sockaddr *)&socket_storage, address, length);
     }
 
     client->fd = client_fd;
@@ -135,33 +101,32 @@ static int gs_tcp_socket_accept(struct gs_socket_t *gsocket, char *address, unsi
     return 0;
 }
 
-static int gs_tcp_socket_connect(struct gs_socket_t *gsocket, const char *address)
+static int gs_tcp_socket_connect(struct gs_socket_t *gsocket, const struct gs_addr_t *address)
 {
     if (gsocket->fd >= 0) {
         return -1;
     }
 
-    struct ipv4_address_t ip_addr;
-    memset(&ip_addr, 0, sizeof(struct ipv4_address_t));
-
-    if (address_to_ipv4(address, &ip_addr) < 0) {
-        return -1;
-    }
+    const int type = (gsocket->flags & GS_SOCKET_FLAG_NONBLOCK) ? (SOCK_STREAM | SOCK_NONBLOCK) : SOCK_STREAM;
 
-    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int fd = socket(address->storage.ss_family, type, 0);
 
     if (fd < 0) {
         return -1;
     }
 
-    struct sockaddr_in socket_addr;
-    memset(&socket_addr, 0, sizeof(struct sockaddr_in));
+    if (gs_socket_apply_opts(gsocket, fd, GS_SOCKET_ROLE_CLIENT) < 0) {
+        close(fd);
+        return -1;
+    }
 
-    socket_addr.sin_family = AF_INET;
-    socket_addr.sin_port = htons(ip_addr.port);
-    socket_addr.sin_addr.s_addr = inet_addr(ip_addr.ip);
+    if (connect(fd, (const struct sockaddr *)&address->storage, address->length) < 0) {
+        /* A non-blocking connect keeps the descriptor until it completes. */
+        if (errno == EINPROGRESS) {
+            gsocket->fd = fd;
+            return -1;
+        }
 
-    if (connect(fd, (struct sockaddr *)&socket_addr, sizeof(socket_addr)) < 0) {
         close(fd);
         return -1;
     }
@@ -207,6 +172,47 @@ static int gs_tcp_socket_recv(struct gs_socket_t *gsocket, void *data, unsigned
     return recvmsg(gsocket->fd, &messagehdr, flags);
 }
 
+static int gs_tcp_socket_sendv(struct gs_socket_t *gsocket, const struct iovec *iov, unsigned int count, int flags)
+{
+    struct msghdr messagehdr;
+    memset(&messagehdr, 0, sizeof(struct msghdr));
+
+    messagehdr.msg_iov = (struct iovec *)iov;
+    messagehdr.msg_iovlen = count;
+    messagehdr.msg_control = NULL;
+    messagehdr.msg_controllen = 0;
+
+    return sendmsg(gsocket->fd, &messagehdr, flags);
+}
+
+static int gs_tcp_socket_recvv(struct gs_socket_t *gsocket, const struct iovec *iov, unsigned int count, int flags)
+{
+    struct msghdr messagehdr;
+    memset(&messagehdr, 0, sizeof(struct msghdr));
+
+    messagehdr.msg_iov = (struct iovec *)iov;
+    messagehdr.msg_iovlen = count;
+    messagehdr.msg_control = NULL;
+    messagehdr.msg_controllen = 0;
+
+    return recvmsg(gsocket->fd, &messagehdr, flags);
+}
+
+static int gs_tcp_socket_sendfile(struct gs_socket_t *gsocket, int file_fd, off_t *offset, size_t count)
+{
+    return sendfile(gsocket->fd, file_fd, offset, count);
+}
+
+static int gs_tcp_socket_send_batch(struct gs_socket_t *gsocket, struct mmsghdr *messages, unsigned int count, int flags)
+{
+    return sendmmsg(gsocket->fd, messages, count, flags);
+}
+
+static int gs_tcp_socket_recv_batch(struct gs_socket_t *gsocket, struct mmsghdr *messages, unsigned int count, int flags)
+{
+    return recvmmsg(gsocket->fd, messages, count, flags, NULL);
+}
+
 const struct gs_socket_base_t *gs_tcp_socket_base(void)
 {
     static struct gs_socket_base_t base = {
@@ -214,9 +220,15 @@ const struct gs_socket_base_t *gs_tcp_socket_base(void)
         .close = gs_tcp_socket_close,
         .bind = gs_tcp_socket_bind,
         .accept = gs_tcp_socket_accept,
+        .accept4 = gs_socket_accept4,
         .connect = gs_tcp_socket_connect,
         .send = gs_tcp_socket_send,
-        .recv = gs_tcp_socket_recv
+        .recv = gs_tcp_socket_recv,
+        .sendv = gs_tcp_socket_sendv,
+        .recvv = gs_tcp_socket_recvv,
+        .send_batch = gs_tcp_socket_send_batch,
+        .recv_batch = gs_tcp_socket_recv_batch,
+        .sendfile = gs_tcp_socket_sendfile
     };
 
     return &base;
@@ -0,0 +1,217 @@
+#include "timer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * A hashed hierarchical wheel: level 0 holds the timers due within 64
+ * ticks, one per slot, and every level above covers 64 times the range of
+ * the one below. Whenever level 0 wraps, one slot of the next level is
+ * cascaded down, so a timer moves at most once per level. Insertion and
+ * removal are O(1), and empty stretches are skipped using the occupancy
+ * bitmaps instead of visiting every tick.
+ */
+#define GS_TIMER_LEVELS 5
+#define GS_TIMER_SLOT_BITS 6
+#define GS_TIMER_SLOTS (1U << GS_TIMER_SLOT_BITS)
+#define GS_TIMER_SLOT_MASK (GS_TIMER_SLOTS - 1)
+
+/* About 12 days in milliseconds, longer timers are placed again at every cascade. */
+#define GS_TIMER_MAX_DELTA ((1ULL << (GS_TIMER_LEVELS * GS_TIMER_SLOT_BITS)) - 1)
+
+struct gs_timer_wheel_t
+{
+    /* The next tick to process. */
+    unsigned long long now;
+    unsigned int count;
+
+    unsigned long long occupied[GS_TIMER_LEVELS];
+    struct gs_timer_t *slots[GS_TIMER_LEVELS][GS_TIMER_SLOTS];
+};
+
+static void gs_timer_wheel_link(struct gs_timer_wheel_t *wheel, struct gs_timer_t *timer)
+{
+    unsigned long long position = (timer->expires > wheel->now) ? timer->expires : wheel->now;
+    unsigned long long delta = position - wheel->now;
+
+    if (delta > GS_TIMER_MAX_DELTA) {
+        delta = GS_TIMER_MAX_DELTA;
+        position = wheel->now + delta;
+    }
+
+    unsigned int level = 0;
+
+    while ((level < GS_TIMER_LEVELS - 1) && (delta >> ((level + 1) * GS_TIMER_SLOT_BITS))) {
+        ++level;
+    }
+
+    const unsigned int slot = (unsigned int)(position >> (level * GS_TIMER_SLOT_BITS)) & GS_TIMER_SLOT_MASK;
+    struct gs_timer_t **bucket = &wheel->slots[level][slot];
+
+    timer->prev = NULL;
+    timer->next = *bucket;
+
+    if (*bucket) {
+        (*bucket)->prev = timer;
+    }
+
+    *bucket = timer;
+    timer->bucket = bucket;
+
+    wheel->occupied[level] |= 1ULL << slot;
+}
+
+static void gs_timer_wheel_unlink(struct gs_timer_wheel_t *wheel, struct gs_timer_t *timer)
+{
+    struct gs_timer_t **bucket = timer->bucket;
+
+    if (timer->prev) {
+        timer->prev->next = timer->next;
+    }
+    else {
+        *bucket = timer->next;
+    }
+
+    if (timer->next) {
+        timer->next->prev = timer->prev;
+    }
+
+    if (!*bucket) {
+        const size_t index = (size_t)(bucket - &wheel->slots[0][0]);
+
+        wheel->occupied[index / GS_TIMER_SLOTS] &= ~(1ULL << (index % GS_TIMER_SLOTS));
+    }
+
+    timer->bucket = NULL;
+    timer->prev = NULL;
+    timer->next = NULL;
+}
+
+/* Called when level 0 wraps, moves the next slot of each level that wrapped too one level down. */
+static void gs_timer_wheel_cascade(struct gs_timer_wheel_t *wheel)
+{
+    for (unsigned int level = 1; level < GS_TIMER_LEVELS; ++level) {
+        const unsigned int slot = (unsigned int)(wheel->now >> (level * GS_TIMER_SLOT_BITS)) & GS_TIMER_SLOT_MASK;
+        struct gs_timer_t *timer = wheel->slots[level][slot];
+
+        wheel->slots[level][slot] = NULL;
+        wheel->occupied[level] &= ~(1ULL << slot);
+
+        while (timer) {
+            struct gs_timer_t *next = timer->next;
+
+            gs_timer_wheel_link(wheel, timer);
+            timer = next;
+        }
+
+        if (slot) {
+            break;
+        }
+    }
+}
+
+struct gs_timer_wheel_t * gs_timer_wheel_create(unsigned long long now)
+{
+    struct gs_timer_wheel_t *wheel = (struct gs_timer_wheel_t *)calloc(1, sizeof(struct gs_timer_wheel_t));
+
+    if (wheel) {
+        wheel->now = now;
+    }
+
+    return wheel;
+}
+
+void gs_timer_wheel_destroy(struct gs_timer_wheel_t *wheel)
+{
+    free(wheel);
+}
+
+void gs_timer_wheel_add(struct gs_timer_wheel_t *wheel, struct gs_timer_t *timer, unsigned long long expires)
+{
+    timer->expires = expires;
+
+    gs_timer_wheel_link(wheel, timer);
+    ++wheel->count;
+}
+
+void gs_timer_wheel_remove(struct gs_timer_wheel_t *wheel, struct gs_timer_t *timer)
+{
+    if (!timer->bucket) {
+        return;
+    }
+
+    gs_timer_wheel_unlink(wheel, timer);
+    --wheel->count;
+}
+
+unsigned int gs_timer_wheel_advance(struct gs_timer_wheel_t *wheel, struct gs_loop_t *loop, unsigned long long now)
+{
+    unsigned int fired = 0;
+
+    while (wheel->now <= now) {
+        if (!wheel->count) {
+            wheel->now = now + 1;
+            break;
+        }
+
+        const unsigned int slot = (unsigned int)wheel->now & GS_TIMER_SLOT_MASK;
+
+        if (!slot) {
+            gs_timer_wheel_cascade(wheel);
+        }
+
+        /* Moving on first makes a timer re-armed by its handler land in a later slot. */
+        ++wheel->now;
+
+        struct gs_timer_t **bucket = &wheel->slots[0][slot];
+
+        while (*bucket) {
+            struct gs_timer_t *timer = *bucket;
+
+            gs_timer_wheel_unlink(wheel, timer);
+            --wheel->count;
+
+            timer->handler(loop, timer, timer->user_data);
+            ++fired;
+        }
+
+        /* Nothing can fire before the next cascade once level 0 is empty. */
+        if (!wheel->occupied[0] && (wheel->now & GS_TIMER_SLOT_MASK)) {
+            const unsigned long long boundary = (wheel->now | GS_TIMER_SLOT_MASK) + 1;
+
+            wheel->now = (boundary <= now) ? boundary : (now + 1);
+        }
+    }
+
+    return fired;
+}
+
+unsigned long long gs_timer_wheel_next(const struct gs_timer_wheel_t *wheel)
+{
+    if (!wheel->count) {
+        return 0;
+    }
+
+    unsigned long long next = 0;
+
+    for (unsigned int level = 0; level < GS_TIMER_LEVELS; ++level) {
+        const unsigned long long occupied = wheel->occupied[level];
+
+        if (!occupied) {
+            continue;
+        }
+
+        /* A slot of this level is reached at the first tick whose lower bits are all zero. */
+        const unsigned int shift = level * GS_TIMER_SLOT_BITS;
+        const unsigned long long base = (wheel->now + (1ULL << shift) - 1) >> shift;
+        const unsigned int start = (unsigned int)base & GS_TIMER_SLOT_MASK;
+        const unsigned long long rotated = start ? ((occupied >> start) | (occupied << (GS_TIMER_SLOTS - start))) : occupied;
+        const unsigned long long tick = (base + (unsigned long long)__builtin_ctzll(rotated)) << shift;
+
+        if (!next || (tick < next)) {
+            next = tick;
+        }
+    }
+
+    return next;
+}
@@ -0,0 +1,32 @@
+#ifndef GS_TIMER_H_
+#define GS_TIMER_H_
+
+#include "loop.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct gs_timer_wheel_t;
+
+/* Ticks are milliseconds of CLOCK_MONOTONIC, `now` is the first one to be processed. */
+struct gs_timer_wheel_t * gs_timer_wheel_create(unsigned long long now);
+
+void gs_timer_wheel_destroy(struct gs_timer_wheel_t *wheel);
+
+/* Links a stopped timer, a tick already passed fires on the next advance. */
+void gs_timer_wheel_add(struct gs_timer_wheel_t *wheel, struct gs_timer_t *timer, unsigned long long expires);
+
+void gs_timer_wheel_remove(struct gs_timer_wheel_t *wheel, struct gs_timer_t *timer);
+
+/* Fires every timer due at or before `now`, returns how many. */
+unsigned int gs_timer_wheel_advance(struct gs_timer_wheel_t *wheel, struct gs_loop_t *loop, unsigned long long now);
+
+/* The first tick at which the wheel has work to do, 0 when it is empty. */
+unsigned long long gs_timer_wheel_next(const struct gs_timer_wheel_t *wheel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* GS_TIMER_H_ */
@@ -0,0 +1,165 @@
+#include "udp_socket.h"
+#include "inet.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+static int gs_udp_socket_init(struct gs_socket_t *gsocket)
+{
+    gsocket->fd = -1;
+    gsocket->address[0] = '\0';
+
+    return 0;
+}
+
+static int gs_udp_socket_close(struct gs_socket_t *gsocket)
+{
+    if (gsocket->fd >= 0) {
+        close(gsocket->fd);
+        gsocket->fd = -1;
+    }
+
+    gsocket->address[0] = '\0';
+
+    return 0;
+}
+
+static int gs_udp_socket_bind(struct gs_socket_t *gsocket, const struct gs_addr_t *address, int backlog)
+{
+    (void)backlog;
+
+    if (gsocket->fd >= 0) {
+        return -1;
+    }
+
+    int fd = socket(address->storage.ss_family, SOCK_DGRAM, 0);
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (gs_socket_apply_opts(gsocket, fd, GS_SOCKET_ROLE_LISTENER) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    if (gs_inet_dual_stack(fd, address->storage.ss_family) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    if (gsocket->flags & GS_SOCKET_FLAG_REUSEPORT) {
+        const int enable = 1;
+
+        if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) < 0) {
+            close(fd);
+            return -1;
+        }
+    }
+
+    if (bind(fd, (const struct sockaddr *)&address->storage, address->length) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    gsocket->fd = fd;
+    gs_socket_set_address(gsocket, address->text);
+
+    return 0;
+}
+
+static int gs_udp_socket_connect(struct gs_socket_t *gsocket, const struct gs_addr_t *address)
+{
+    if (gsocket->fd >= 0) {
+        return -1;
+    }
+
+    const int type = (gsocket->flags & GS_SOCKET_FLAG_NONBLOCK) ? (SOCK_DGRAM | SOCK_NONBLOCK) : SOCK_DGRAM;
+
+    int fd = socket(address->storage.ss_family, type, 0);
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (gs_socket_apply_opts(gsocket, fd, GS_SOCKET_ROLE_CLIENT) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    if (connect(fd, (const struct sockaddr *)&address->storage, address->length) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    gsocket->fd = fd;
+
+    return 0;
+}
+
+static int gs_udp_socket_send(struct gs_socket_t *gsocket, const void *data, unsigned int length, int flags)
+{
+    return send(gsocket->fd, data, length, flags);
+}
+
+static int gs_udp_socket_recv(struct gs_socket_t *gsocket, void *data, unsigned int length, int flags)
+{
+    return recv(gsocket->fd, data, length, flags);
+}
+
+static int gs_udp_socket_sendv(struct gs_socket_t *gsocket, const struct iovec *iov, unsigned int count, int flags)
+{
+    struct msghdr messagehdr;
+    memset(&messagehdr, 0, sizeof(struct msghdr));
+
+    messagehdr.msg_iov = (struct iovec *)iov;
+    messagehdr.msg_iovlen = count;
+
+    return sendmsg(gsocket->fd, &messagehdr, flags);
+}
+
+static int gs_udp_socket_recvv(struct gs_socket_t *gsocket, const struct iovec *iov, unsigned int count, int flags)
+{
+    struct msghdr messagehdr;
+    memset(&messagehdr, 0, sizeof(struct msghdr));
+
+    messagehdr.msg_iov = (struct iovec *)iov;
+    messagehdr.msg_iovlen = count;
+
+    return recvmsg(gsocket->fd, &messagehdr, flags);
+}
+
+static int gs_udp_socket_send_batch(struct gs_socket_t *gsocket, struct mmsghdr *messages, unsigned int count, int flags)
+{
+    return sendmmsg(gsocket->fd, messages, count, flags);
+}
+
+static int gs_udp_socket_recv_batch(struct gs_socket_t *gsocket, struct mmsghdr *messages, unsigned int count, int flags)
+{
+    return recvmmsg(gsocket->fd, messages, count, flags, NULL);
+}
+
+const struct gs_socket_base_t * gs_udp_socket_base(void)
+{
+    static const struct gs_socket_base_t base = {
+        .init = gs_udp_socket_init,
+        .close = gs_udp_socket_close,
+        .bind = gs_udp_socket_bind,
+        .accept = NULL,
+        .accept4 = NULL,
+        .connect = gs_udp_socket_connect,
+        .send = gs_udp_socket_send,
+        .recv = gs_udp_socket_recv,
+        .sendv = gs_udp_socket_sendv,
+        .recvv = gs_udp_socket_recvv,
+        .send_batch = gs_udp_socket_send_batch,
+        .recv_batch = gs_udp_socket_recv_batch
+    };
+
+    return &base;
+}
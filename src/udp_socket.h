@@ -0,0 +1,16 @@
+#ifndef GS_UDP_SOCKET_H_
+#define GS_UDP_SOCKET_H_
+
+#include "socket.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+const struct gs_socket_base_t * gs_udp_socket_base(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* GS_UDP_SOCKET_H_ */
@@ -1,78 +1,101 @@
 #include "unix_socket.h"
 
 #include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
 #include <sys/socket.h>
+#include <sys/sendfile.h>
 #include <sys/types.h>
 #include <sys/un.h>
 
+static inline int gs_unix_socket_type(const struct gs_socket_t *gsocket)
+{
+    switch (gsocket->domain) {
+        case GS_SOCKET_DOMAIN_UNIX_DGRAM:
+            return SOCK_DGRAM;
+        case GS_SOCKET_DOMAIN_UNIX_SEQPACKET:
+            return SOCK_SEQPACKET;
+        default:
+            return SOCK_STREAM;
+    }
+}
+
 static int gs_unix_socket_init(struct gs_socket_t *gsocket)
 {
     gsocket->fd = -1;
-    gsocket->address = NULL;
+    gsocket->address[0] = '\0';
 
     return 0;
 }
 
 static int gs_unix_socket_close(struct gs_socket_t *gsocket)
 {
+    /* Flag the rings as closed before the peer sees the socket go away. */
+    gs_shm_destroy(gsocket->shm);
+    gsocket->shm = NULL;
+
     if (gsocket->fd >= 0) {
         close(gsocket->fd);
         gsocket->fd = -1;
     }
 
-    if (gsocket->address) {
-        if (gsocket->address[0] != '@') {
-            unlink(gsocket->address);
-        }
-
-        free(gsocket->address);
-        gsocket->address = NULL;
+    /* A listener handed off to a successor keeps its path, the successor owns it now. */
+    if (gsocket->address[0] && (gsocket->address[0] != '@') && !(gsocket->flags & GS_SOCKET_FLAG_HANDOFF)) {
+        unlink(gsocket->address);
     }
 
+    gsocket->address[0] = '\0';
+
     return 0;
 }
 
-static int gs_unix_socket_bind(struct gs_socket_t *gsocket, const char *address, int backlog)
+static int gs_unix_socket_bind(struct gs_socket_t *gsocket, const struct gs_addr_t *address, int backlog)
 {
     if (gsocket->fd >= 0) {
         return -1;
     }
 
-    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    const int type = gs_unix_socket_type(gsocket);
+
+    int fd = socket(AF_UNIX, type, 0);
 
     if (fd < 0) {
         return -1;
     }
 
-    struct sockaddr_un socket_addr;
-    memset(&socket_addr, 0, sizeof(struct sockaddr_un));
-    socket_addr.sun_family = AF_UNIX;
-
-    snprintf(socket_addr.sun_path, sizeof(socket_addr.sun_path), "%s", address);
-
-    if (socket_addr.sun_path[0] == '@') {
-        socket_addr.sun_path[0] = '\0';
+    if (gs_socket_apply_opts(gsocket, fd, GS_SOCKET_ROLE_LISTENER) < 0) {
+        close(fd);
+        return -1;
     }
 
-    if (bind(fd, &socket_addr, sizeof(struct sockaddr_un)) < 0) {
+    if (bind(fd, (const struct sockaddr *)&address->storage, address->length) < 0) {
         close(fd);
         return -1;
     }
 
-    if (listen(fd, backlog) < 0) {
+    if ((type != SOCK_DGRAM) && (listen(fd, backlog) < 0)) {
         close(fd);
         return -1;
     }
 
     gsocket->fd = fd;
-    gsocket->address = strdup(address);
+    gs_socket_set_address(gsocket, address->text);
 
     return 0;
 }
 
+/* A client's offer is taken by its first data call, so accepting never waits for it. */
+static inline void gs_unix_socket_accepted(const struct gs_socket_t *gsocket, struct gs_socket_t *client)
+{
+    if (gsocket->flags & GS_SOCKET_FLAG_SHM) {
+        client->flags |= GS_SOCKET_FLAG_SHM_PENDING;
+    }
+}
+
 static int gs_unix_socket_accept(struct gs_socket_t *gsocket, char *address, unsigned int length, struct gs_socket_t *client)
 {
     struct sockaddr_storage socket_storage;
@@ -88,38 +111,73 @@ static int gs_unix_socket_accept(struct gs_socket_t *gsocket, char *address, uns
     }
 
     client->fd = client_fd;
+    gs_unix_socket_accepted(gsocket, client);
 
     if (address && length) {
-        snprintf(address, length, "%s", socket_addr->sun_path);
+        gs_unix_format((const struct sockaddr *)socket_addr, socket_length, address, length);
     }
 
     return 0;
 }
 
-static int gs_unix_socket_connect(struct gs_socket_t *gsocket, const char *address)
+static int gs_unix_socket_accept4(struct gs_socket_t *gsocket, struct sockaddr *address, socklen_t *length, int flags, struct gs_socket_t *client)
+{
+    if (gs_socket_accept4(gsocket, address, length, flags, client) < 0) {
+        return -1;
+    }
+
+    gs_unix_socket_accepted(gsocket, client);
+
+    return 0;
+}
+
+static int gs_unix_socket_connect(struct gs_socket_t *gsocket, const struct gs_addr_t *address)
 {
     if (gsocket->fd >= 0) {
         return -1;
     }
 
-    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    /* The shared-memory handshake needs the connection established. */
+    if ((gsocket->flags & (GS_SOCKET_FLAG_SHM | GS_SOCKET_FLAG_NONBLOCK)) == (GS_SOCKET_FLAG_SHM | GS_SOCKET_FLAG_NONBLOCK)) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    const int type = gs_unix_socket_type(gsocket) | ((gsocket->flags & GS_SOCKET_FLAG_NONBLOCK) ? SOCK_NONBLOCK : 0);
+
+    int fd = socket(AF_UNIX, type, 0);
 
     if (fd < 0) {
         return -1;
     }
 
-    struct sockaddr_un socket_addr;
-    memset(&socket_addr, 0, sizeof(struct sockaddr_un));
-    socket_addr.sun_family = AF_UNIX;
+    if (gs_socket_apply_opts(gsocket, fd, GS_SOCKET_ROLE_CLIENT) < 0) {
+        close(fd);
+        return -1;
+    }
 
-    snprintf(socket_addr.sun_path, sizeof(socket_addr.sun_path), "%s", address);
+    if ((gsocket->flags & GS_SOCKET_FLAG_AUTOBIND) && (gs_unix_autobind(fd) < 0)) {
+        close(fd);
+        return -1;
+    }
 
-    if (socket_addr.sun_path[0] == '@') {
-        socket_addr.sun_path[0] = '\0';
+    if (connect(fd, (const struct sockaddr *)&address->storage, address->length) < 0) {
+        /* A non-blocking connect keeps the descriptor until it completes. */
+        if (errno == EINPROGRESS) {
+            gsocket->fd = fd;
+            return -1;
+        }
+
+        close(fd);
+        return -1;
     }
 
-    if (connect(fd, &socket_addr, sizeof(struct sockaddr_un)) < 0) {
+    if ((gsocket->flags & GS_SOCKET_FLAG_SHM) && (gs_shm_offer(gsocket, fd) < 0)) {
+        const int error = errno;
+
         close(fd);
+
+        errno = error;
         return -1;
     }
 
@@ -135,6 +193,14 @@ static int gs_unix_socket_send(struct gs_socket_t *gsocket, const void *data, un
     iov.iov_base = (void *)data;
     iov.iov_len = length;
 
+    if ((gsocket->flags & GS_SOCKET_FLAG_SHM_PENDING) && (gs_shm_attach(gsocket, flags) < 0)) {
+        return -1;
+    }
+
+    if (gsocket->shm) {
+        return gs_shm_sendv(gsocket, &iov, 1, flags);
+    }
+
     struct msghdr message_header;
     memset(&message_header, 0, sizeof(struct msghdr));
     message_header.msg_iov = &iov;
@@ -152,6 +218,14 @@ static int gs_unix_socket_recv(struct gs_socket_t *gsocket, void *data, unsigned
     iov.iov_base = data;
     iov.iov_len = length;
 
+    if ((gsocket->flags & GS_SOCKET_FLAG_SHM_PENDING) && (gs_shm_attach(gsocket, flags) < 0)) {
+        return -1;
+    }
+
+    if (gsocket->shm) {
+        return gs_shm_recvv(gsocket, &iov, 1, flags);
+    }
+
     struct msghdr message_header;
     memset(&message_header, 0, sizeof(struct msghdr));
     message_header.msg_iov = &iov;
@@ -162,6 +236,232 @@ static int gs_unix_socket_recv(struct gs_socket_t *gsocket, void *data, unsigned
     return recvmsg(gsocket->fd, &message_header, flags);
 }
 
+static int gs_unix_socket_sendv(struct gs_socket_t *gsocket, const struct iovec *iov, unsigned int count, int flags)
+{
+    if ((gsocket->flags & GS_SOCKET_FLAG_SHM_PENDING) && (gs_shm_attach(gsocket, flags) < 0)) {
+        return -1;
+    }
+
+    if (gsocket->shm) {
+        return gs_shm_sendv(gsocket, iov, count, flags);
+    }
+
+    struct msghdr message_header;
+    memset(&message_header, 0, sizeof(struct msghdr));
+    message_header.msg_iov = (struct iovec *)iov;
+    message_header.msg_iovlen = count;
+    message_header.msg_control = NULL;
+    message_header.msg_controllen = 0;
+
+    return sendmsg(gsocket->fd, &message_header, flags);
+}
+
+static int gs_unix_socket_recvv(struct gs_socket_t *gsocket, const struct iovec *iov, unsigned int count, int flags)
+{
+    if ((gsocket->flags & GS_SOCKET_FLAG_SHM_PENDING) && (gs_shm_attach(gsocket, flags) < 0)) {
+        return -1;
+    }
+
+    if (gsocket->shm) {
+        return gs_shm_recvv(gsocket, iov, count, flags);
+    }
+
+    struct msghdr message_header;
+    memset(&message_header, 0, sizeof(struct msghdr));
+    message_header.msg_iov = (struct iovec *)iov;
+    message_header.msg_iovlen = count;
+    message_header.msg_control = NULL;
+    message_header.msg_controllen = 0;
+
+    return recvmsg(gsocket->fd, &message_header, flags);
+}
+
+static int gs_unix_socket_sendfile(struct gs_socket_t *gsocket, int file_fd, off_t *offset, size_t count)
+{
+    if (gs_socket_shm(gsocket)) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    return sendfile(gsocket->fd, file_fd, offset, count);
+}
+
+static int gs_unix_socket_send_batch(struct gs_socket_t *gsocket, struct mmsghdr *messages, unsigned int count, int flags)
+{
+    if (gs_socket_shm(gsocket)) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    return sendmmsg(gsocket->fd, messages, count, flags);
+}
+
+static int gs_unix_socket_recv_batch(struct gs_socket_t *gsocket, struct mmsghdr *messages, unsigned int count, int flags)
+{
+    if (gs_socket_shm(gsocket)) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    return recvmmsg(gsocket->fd, messages, count, flags, NULL);
+}
+
+int gs_unix_send_fds(int fd, const void *data, unsigned int length, const int *fds, unsigned int count, int flags)
+{
+    if (count > GS_MAX_FDS) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    struct iovec iov;
+    memset(&iov, 0, sizeof(struct iovec));
+    iov.iov_base = (void *)data;
+    iov.iov_len = length;
+
+    union {
+        char buffer[CMSG_SPACE(sizeof(int) * GS_MAX_FDS)];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct msghdr message_header;
+    memset(&message_header, 0, sizeof(struct msghdr));
+    message_header.msg_iov = &iov;
+    message_header.msg_iovlen = 1;
+
+    if (count) {
+        message_header.msg_control = control.buffer;
+        message_header.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message_header);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * count);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * count);
+    }
+
+    return sendmsg(fd, &message_header, flags);
+}
+
+int gs_unix_recv_fds(int fd, void *data, unsigned int length, int *fds, unsigned int *count, struct gs_cred_t *cred, int flags)
+{
+    struct iovec iov;
+    memset(&iov, 0, sizeof(struct iovec));
+    iov.iov_base = data;
+    iov.iov_len = length;
+
+    union {
+        char buffer[CMSG_SPACE(sizeof(int) * GS_MAX_FDS) + CMSG_SPACE(sizeof(struct ucred))];
+        struct cmsghdr align;
+    } control;
+
+    struct msghdr message_header;
+    memset(&message_header, 0, sizeof(struct msghdr));
+    message_header.msg_iov = &iov;
+    message_header.msg_iovlen = 1;
+    message_header.msg_control = control.buffer;
+    message_header.msg_controllen = sizeof(control.buffer);
+
+    const int bytes = recvmsg(fd, &message_header, flags | MSG_CMSG_CLOEXEC);
+
+    if (bytes < 0) {
+        return -1;
+    }
+
+    const unsigned int room = count ? *count : 0;
+    unsigned int received = 0;
+
+    if (cred) {
+        memset(cred, 0, sizeof(struct gs_cred_t));
+    }
+
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message_header); cmsg; cmsg = CMSG_NXTHDR(&message_header, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET) {
+            continue;
+        }
+
+        if (cmsg->cmsg_type == SCM_RIGHTS) {
+            const unsigned int passed = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+
+            for (unsigned int index = 0; index < passed; ++index) {
+                int passed_fd = -1;
+                memcpy(&passed_fd, CMSG_DATA(cmsg) + index * sizeof(int), sizeof(int));
+
+                /* The descriptors are already installed, leaking the extra ones is not an option. */
+                if (received < room) {
+                    fds[received++] = passed_fd;
+                }
+                else {
+                    close(passed_fd);
+                }
+            }
+        }
+        else if ((cmsg->cmsg_type == SCM_CREDENTIALS) && cred) {
+            struct ucred sender;
+            memcpy(&sender, CMSG_DATA(cmsg), sizeof(struct ucred));
+
+            cred->pid = sender.pid;
+            cred->uid = sender.uid;
+            cred->gid = sender.gid;
+        }
+    }
+
+    if (count) {
+        *count = received;
+    }
+
+    return bytes;
+}
+
+static int gs_unix_socket_send_fds(struct gs_socket_t *gsocket, const void *data, unsigned int length, const int *fds, unsigned int count, int flags)
+{
+    if (gs_socket_shm(gsocket)) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    return gs_unix_send_fds(gsocket->fd, data, length, fds, count, flags);
+}
+
+static int gs_unix_socket_recv_fds(struct gs_socket_t *gsocket, void *data, unsigned int length, int *fds, unsigned int *count, struct gs_cred_t *cred, int flags)
+{
+    if (gs_socket_shm(gsocket)) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    return gs_unix_recv_fds(gsocket->fd, data, length, fds, count, cred, flags);
+}
+
+int gs_unix_autobind(int fd)
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(struct sockaddr_un));
+    address.sun_family = AF_UNIX;
+
+    /* Nothing but the family, the kernel then chooses five hex digits in the abstract namespace. */
+    return bind(fd, (const struct sockaddr *)&address, (socklen_t)offsetof(struct sockaddr_un, sun_path));
+}
+
+int gs_unix_format(const struct sockaddr *address, socklen_t address_length, char *buffer, unsigned int length)
+{
+    const struct sockaddr_un *unix_address = (const struct sockaddr_un *)address;
+    const socklen_t offset = (socklen_t)offsetof(struct sockaddr_un, sun_path);
+
+    if (address_length <= offset) {
+        return snprintf(buffer, length, "%s", "");
+    }
+
+    const int name_length = (int)(address_length - offset);
+
+    /* Abstract names are not NUL-terminated, only the length delimits them. */
+    if (unix_address->sun_path[0] == '\0') {
+        return snprintf(buffer, length, "@%.*s", name_length - 1, unix_address->sun_path + 1);
+    }
+
+    return snprintf(buffer, length, "%.*s", name_length, unix_address->sun_path);
+}
+
 const struct gs_socket_base_t * gs_unix_socket_base(void)
 {
     static const struct gs_socket_base_t base = {
@@ -169,10 +469,46 @@ const struct gs_socket_base_t * gs_unix_socket_base(void)
         .close = gs_unix_socket_close,
         .bind = gs_unix_socket_bind,
         .accept = gs_unix_socket_accept,
+        .accept4 = gs_unix_socket_accept4,
         .connect = gs_unix_socket_connect,
         .send = gs_unix_socket_send,
-        .recv = gs_unix_socket_recv
+        .recv = gs_unix_socket_recv,
+        .sendv = gs_unix_socket_sendv,
+        .recvv = gs_unix_socket_recvv,
+        .send_batch = gs_unix_socket_send_batch,
+        .recv_batch = gs_unix_socket_recv_batch,
+        .sendfile = gs_unix_socket_sendfile,
+        .send_fds = gs_unix_socket_send_fds,
+        .recv_fds = gs_unix_socket_recv_fds
     };
 
     return &base;
-}
\ No newline at end of file
+}
+
+const struct gs_socket_base_t * gs_unix_dgram_socket_base(void)
+{
+    static const struct gs_socket_base_t base = {
+        .init = gs_unix_socket_init,
+        .close = gs_unix_socket_close,
+        .bind = gs_unix_socket_bind,
+        .accept = NULL,
+        .accept4 = NULL,
+        .connect = gs_unix_socket_connect,
+        .send = gs_unix_socket_send,
+        .recv = gs_unix_socket_recv,
+        .sendv = gs_unix_socket_sendv,
+        .recvv = gs_unix_socket_recvv,
+        .send_batch = gs_unix_socket_send_batch,
+        .recv_batch = gs_unix_socket_recv_batch,
+        .sendfile = NULL,
+        .send_fds = gs_unix_socket_send_fds,
+        .recv_fds = gs_unix_socket_recv_fds
+    };
+
+    return &base;
+}
+
+const struct gs_socket_base_t * gs_unix_seqpacket_socket_base(void)
+{
+    return gs_unix_socket_base();
+}
@@ -9,6 +9,21 @@ extern "C" {
 
 const struct gs_socket_base_t * gs_unix_socket_base(void);
 
+const struct gs_socket_base_t * gs_unix_dgram_socket_base(void);
+
+const struct gs_socket_base_t * gs_unix_seqpacket_socket_base(void);
+
+/* gs_send_fds()/gs_recv_fds() on a raw descriptor, also used by the shared-memory handshake. */
+int gs_unix_send_fds(int fd, const void *data, unsigned int length, const int *fds, unsigned int count, int flags);
+
+int gs_unix_recv_fds(int fd, void *data, unsigned int length, int *fds, unsigned int *count, struct gs_cred_t *cred, int flags);
+
+/* Binds to a unique abstract name picked by the kernel. */
+int gs_unix_autobind(int fd);
+
+/* Formats a sockaddr_un of `address_length` bytes as a path or "@abstract", unnamed sockets as "". */
+int gs_unix_format(const struct sockaddr *address, socklen_t address_length, char *buffer, unsigned int length);
+
 #ifdef __cplusplus
 }
 #endif
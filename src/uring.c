@@ -0,0 +1,631 @@
+#include "uring.h"
+#include "gs.h"
+#include "socket.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+/* Buffer group the pool is provided under. */
+#define GS_URING_BUFFER_GROUP 0
+
+/* Completion slots per submission slot, headroom for multishot requests. */
+#define GS_URING_CQ_FACTOR 4
+
+struct gs_uring_request_t
+{
+    int op;
+    bool multishot;
+
+    struct gs_socket_t *gsocket;
+    void *data;
+
+    gs_uring_handler_t handler;
+    void *user_data;
+
+    struct gs_uring_request_t *next;
+};
+
+struct gs_uring_t
+{
+    int fd;
+
+    void *sq_ring;
+    size_t sq_ring_size;
+    unsigned int *sq_head;
+    unsigned int *sq_tail;
+    unsigned int *sq_flags;
+    unsigned int *sq_array;
+    unsigned int sq_mask;
+    unsigned int sq_entries;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    /* Local tail, published to the kernel by gs_uring_enter(). */
+    unsigned int tail;
+    unsigned int pending;
+
+    void *cq_ring;
+    size_t cq_ring_size;
+    unsigned int *cq_head;
+    unsigned int *cq_tail;
+    unsigned int cq_mask;
+    struct io_uring_cqe *cqes;
+
+    /**
+     * One request per submission slot, the CQ is GS_URING_CQ_FACTOR times
+     * larger. Multishot requests complete many times, so a burst can still
+     * fill it; the kernel then keeps the rest and gs_uring_run_once()
+     * flushes them.
+     */
+    struct gs_uring_request_t *requests;
+    struct gs_uring_request_t *free_requests;
+
+    char *buffers;
+    unsigned int buffer_count;
+    unsigned int buffer_size;
+
+    /* Buffers whose return to the kernel could not be queued, retried by gs_uring_run_once(). */
+    unsigned short *unprovided;
+    unsigned int unprovided_count;
+};
+
+static int gs_uring_enter(struct gs_uring_t *ring, unsigned int wait, int timeout)
+{
+    const bool overflow = (__atomic_load_n(ring->sq_flags, __ATOMIC_ACQUIRE) & IORING_SQ_CQ_OVERFLOW) != 0;
+    unsigned int flags = (wait || overflow) ? IORING_ENTER_GETEVENTS : 0;
+    struct io_uring_getevents_arg arg;
+    struct timespec ts;
+    void *argp = NULL;
+    size_t argsz = 0;
+
+    if (wait && (timeout >= 0)) {
+        ts.tv_sec = timeout / 1000;
+        ts.tv_nsec = (timeout % 1000) * 1000000L;
+
+        memset(&arg, 0, sizeof(struct io_uring_getevents_arg));
+        arg.ts = (unsigned long long)(uintptr_t)&ts;
+
+        flags |= IORING_ENTER_EXT_ARG;
+        argp = &arg;
+        argsz = sizeof(arg);
+    }
+
+    __atomic_store_n(ring->sq_tail, ring->tail, __ATOMIC_RELEASE);
+
+    const int submitted = (int)syscall(__NR_io_uring_enter, ring->fd, ring->pending, wait, flags, argp, argsz);
+
+    if (submitted < 0) {
+        /* Expired waits and signals are not failures of the ring. */
+        if ((errno == ETIME) || (errno == EINTR)) {
+            return 0;
+        }
+
+        return -1;
+    }
+
+    ring->pending -= (unsigned int)submitted;
+
+    return submitted;
+}
+
+static struct io_uring_sqe * gs_uring_sqe(struct gs_uring_t *ring)
+{
+    if (ring->tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries) {
+        if (gs_uring_enter(ring, 0, 0) < 0) {
+            return NULL;
+        }
+
+        if (ring->tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries) {
+            errno = EAGAIN;
+            return NULL;
+        }
+    }
+
+    const unsigned int index = ring->tail & ring->sq_mask;
+    struct io_uring_sqe *sqe = ring->sqes + index;
+
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    ring->sq_array[index] = index;
+
+    ++ring->tail;
+    ++ring->pending;
+
+    return sqe;
+}
+
+static struct gs_uring_request_t * gs_uring_request(struct gs_uring_t *ring, int op, struct gs_socket_t *gsocket, gs_uring_handler_t handler, void *user_data)
+{
+    struct gs_uring_request_t *request = ring->free_requests;
+
+    if (!request) {
+        errno = EAGAIN;
+        return NULL;
+    }
+
+    ring->free_requests = request->next;
+
+    memset(request, 0, sizeof(struct gs_uring_request_t));
+    request->op = op;
+    request->gsocket = gsocket;
+    request->handler = handler;
+    request->user_data = user_data;
+
+    return request;
+}
+
+static void gs_uring_request_free(struct gs_uring_t *ring, struct gs_uring_request_t *request)
+{
+    request->next = ring->free_requests;
+    ring->free_requests = request;
+}
+
+/* Queues a request, giving the slot back if the submission queue is full. */
+static struct io_uring_sqe * gs_uring_prepare(struct gs_uring_t *ring, struct gs_uring_request_t *request, int opcode, int fd)
+{
+    struct io_uring_sqe *sqe = gs_uring_sqe(ring);
+
+    if (!sqe) {
+        gs_uring_request_free(ring, request);
+        return NULL;
+    }
+
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->user_data = (unsigned long long)(uintptr_t)request;
+
+    return sqe;
+}
+
+/* Hands buffers back to the kernel, completions of internal requests carry no user data. */
+static int gs_uring_provide(struct gs_uring_t *ring, unsigned int first, unsigned int count)
+{
+    struct io_uring_sqe *sqe = gs_uring_sqe(ring);
+
+    if (!sqe) {
+        return -1;
+    }
+
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = (int)count;
+    sqe->addr = (unsigned long long)(uintptr_t)(ring->buffers + (size_t)first * ring->buffer_size);
+    sqe->len = ring->buffer_size;
+    sqe->off = first;
+    sqe->buf_group = GS_URING_BUFFER_GROUP;
+
+    return 0;
+}
+
+static void gs_uring_unmap(struct gs_uring_t *ring)
+{
+    if (ring->sqes) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+
+    if (ring->cq_ring && (ring->cq_ring != ring->sq_ring)) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+
+    if (ring->sq_ring) {
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    }
+}
+
+static int gs_uring_map(struct gs_uring_t *ring, const struct io_uring_params *params)
+{
+    ring->sq_ring_size = params->sq_off.array + params->sq_entries * sizeof(unsigned int);
+    ring->cq_ring_size = params->cq_off.cqes + params->cq_entries * sizeof(struct io_uring_cqe);
+
+    const bool single = (params->features & IORING_FEAT_SINGLE_MMAP) != 0;
+
+    if (single && (ring->cq_ring_size > ring->sq_ring_size)) {
+        ring->sq_ring_size = ring->cq_ring_size;
+    }
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+
+    if (ring->sq_ring == MAP_FAILED) {
+        ring->sq_ring = NULL;
+        return -1;
+    }
+
+    if (single) {
+        ring->cq_ring = ring->sq_ring;
+    }
+    else {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+
+        if (ring->cq_ring == MAP_FAILED) {
+            ring->cq_ring = NULL;
+            return -1;
+        }
+    }
+
+    ring->sqes_size = params->sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe *)mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        return -1;
+    }
+
+    char *sq = (char *)ring->sq_ring;
+    ring->sq_head = (unsigned int *)(sq + params->sq_off.head);
+    ring->sq_tail = (unsigned int *)(sq + params->sq_off.tail);
+    ring->sq_flags = (unsigned int *)(sq + params->sq_off.flags);
+    ring->sq_array = (unsigned int *)(sq + params->sq_off.array);
+    ring->sq_mask = *(unsigned int *)(sq + params->sq_off.ring_mask);
+    ring->sq_entries = params->sq_entries;
+    ring->tail = *ring->sq_tail;
+
+    char *cq = (char *)ring->cq_ring;
+    ring->cq_head = (unsigned int *)(cq + params->cq_off.head);
+    ring->cq_tail = (unsigned int *)(cq + params->cq_off.tail);
+    ring->cq_mask = *(unsigned int *)(cq + params->cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params->cq_off.cqes);
+
+    return 0;
+}
+
+struct gs_uring_t * gs_uring_create(unsigned int entries, unsigned int buffers, unsigned int buffer_size)
+{
+    if (!entries || (entries > 32768) || (buffers && !buffer_size) || (buffers > 65536)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    struct gs_uring_t *ring = (struct gs_uring_t *)calloc(1, sizeof(struct gs_uring_t));
+
+    if (!ring) {
+        return NULL;
+    }
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(struct io_uring_params));
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+    params.cq_entries = entries * GS_URING_CQ_FACTOR;
+
+    ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+
+    /* Older kernels reject the other flags, they are only optimizations. */
+    if ((ring->fd < 0) && (errno == EINVAL)) {
+        memset(&params, 0, sizeof(struct io_uring_params));
+        params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+        params.cq_entries = entries * GS_URING_CQ_FACTOR;
+        ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    }
+
+    if (ring->fd < 0) {
+        free(ring);
+        return NULL;
+    }
+
+    if (gs_uring_map(ring, &params) < 0) {
+        gs_uring_destroy(ring);
+        return NULL;
+    }
+
+    ring->requests = (struct gs_uring_request_t *)calloc(params.sq_entries, sizeof(struct gs_uring_request_t));
+
+    if (!ring->requests) {
+        gs_uring_destroy(ring);
+        return NULL;
+    }
+
+    for (unsigned int index = 0; index < params.sq_entries; ++index) {
+        gs_uring_request_free(ring, ring->requests + index);
+    }
+
+    if (buffers) {
+        ring->buffers = (char *)malloc((size_t)buffers * buffer_size);
+        ring->unprovided = (unsigned short *)malloc(buffers * sizeof(unsigned short));
+        ring->buffer_count = buffers;
+        ring->buffer_size = buffer_size;
+
+        if (!ring->buffers || !ring->unprovided || (gs_uring_provide(ring, 0, buffers) < 0)) {
+            gs_uring_destroy(ring);
+            return NULL;
+        }
+    }
+
+    return ring;
+}
+
+void gs_uring_destroy(struct gs_uring_t *ring)
+{
+    if (!ring) {
+        return;
+    }
+
+    gs_uring_unmap(ring);
+
+    if (ring->fd >= 0) {
+        close(ring->fd);
+    }
+
+    free(ring->unprovided);
+    free(ring->buffers);
+    free(ring->requests);
+    free(ring);
+}
+
+int gs_uring_accept(struct gs_uring_t *ring, struct gs_socket_t *gsocket, gs_uring_handler_t handler, void *user_data)
+{
+    if (!gsocket->base->accept4) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    struct gs_uring_request_t *request = gs_uring_request(ring, GS_URING_OP_ACCEPT, gsocket, handler, user_data);
+
+    if (!request) {
+        return -1;
+    }
+
+    struct io_uring_sqe *sqe = gs_uring_prepare(ring, request, IORING_OP_ACCEPT, gsocket->fd);
+
+    if (!sqe) {
+        return -1;
+    }
+
+    request->multishot = true;
+
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+
+    return 0;
+}
+
+int gs_uring_connect(struct gs_uring_t *ring, struct gs_socket_t *gsocket, const char *address, gs_uring_handler_t handler, void *user_data)
+{
+    /* The domain parses the address and opens the descriptor, the ring waits for the handshake. */
+    if ((gs_connect_async(gsocket, address) < 0) && (errno != EINPROGRESS)) {
+        return -1;
+    }
+
+    struct gs_uring_request_t *request = gs_uring_request(ring, GS_URING_OP_CONNECT, gsocket, handler, user_data);
+
+    if (!request) {
+        return -1;
+    }
+
+    struct io_uring_sqe *sqe = gs_uring_prepare(ring, request, IORING_OP_POLL_ADD, gsocket->fd);
+
+    if (!sqe) {
+        return -1;
+    }
+
+    sqe->poll32_events = POLLOUT;
+
+    return 0;
+}
+
+int gs_uring_send(struct gs_uring_t *ring, struct gs_socket_t *gsocket, const void *data, unsigned int length, int flags, gs_uring_handler_t handler, void *user_data)
+{
+    /* The data of a shared-memory connection is in the rings, the descriptor only carries wakeups. */
+    if (gs_socket_shm(gsocket)) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    struct gs_uring_request_t *request = gs_uring_request(ring, GS_URING_OP_SEND, gsocket, handler, user_data);
+
+    if (!request) {
+        return -1;
+    }
+
+    struct io_uring_sqe *sqe = gs_uring_prepare(ring, request, IORING_OP_SEND, gsocket->fd);
+
+    if (!sqe) {
+        return -1;
+    }
+
+    sqe->addr = (unsigned long long)(uintptr_t)data;
+    sqe->len = length;
+    sqe->msg_flags = (unsigned int)flags;
+
+    return 0;
+}
+
+int gs_uring_recv(struct gs_uring_t *ring, struct gs_socket_t *gsocket, void *data, unsigned int length, int flags, gs_uring_handler_t handler, void *user_data)
+{
+    if (gs_socket_shm(gsocket)) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    struct gs_uring_request_t *request = gs_uring_request(ring, GS_URING_OP_RECV, gsocket, handler, user_data);
+
+    if (!request) {
+        return -1;
+    }
+
+    struct io_uring_sqe *sqe = gs_uring_prepare(ring, request, IORING_OP_RECV, gsocket->fd);
+
+    if (!sqe) {
+        return -1;
+    }
+
+    request->data = data;
+
+    sqe->addr = (unsigned long long)(uintptr_t)data;
+    sqe->len = length;
+    sqe->msg_flags = (unsigned int)flags;
+
+    return 0;
+}
+
+int gs_uring_recv_multishot(struct gs_uring_t *ring, struct gs_socket_t *gsocket, gs_uring_handler_t handler, void *user_data)
+{
+    if (gs_socket_shm(gsocket)) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    if (!ring->buffers) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    struct gs_uring_request_t *request = gs_uring_request(ring, GS_URING_OP_RECV, gsocket, handler, user_data);
+
+    if (!request) {
+        return -1;
+    }
+
+    struct io_uring_sqe *sqe = gs_uring_prepare(ring, request, IORING_OP_RECV, gsocket->fd);
+
+    if (!sqe) {
+        return -1;
+    }
+
+    request->multishot = true;
+
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = 1U << IOSQE_BUFFER_SELECT_BIT;
+    sqe->buf_group = GS_URING_BUFFER_GROUP;
+
+    return 0;
+}
+
+int gs_uring_cancel(struct gs_uring_t *ring, struct gs_socket_t *gsocket)
+{
+    struct io_uring_sqe *sqe = gs_uring_sqe(ring);
+
+    if (!sqe) {
+        return -1;
+    }
+
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = gsocket->fd;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+
+    return 0;
+}
+
+static void gs_uring_complete(struct gs_uring_t *ring, struct gs_uring_request_t *request, int result, unsigned int flags)
+{
+    struct gs_uring_completion_t completion;
+    memset(&completion, 0, sizeof(struct gs_uring_completion_t));
+    completion.op = request->op;
+    completion.gsocket = request->gsocket;
+    completion.result = result;
+    completion.data = request->data;
+    completion.more = request->multishot && (flags & IORING_CQE_F_MORE);
+
+    int buffer = -1;
+
+    if (flags & IORING_CQE_F_BUFFER) {
+        buffer = (int)(flags >> IORING_CQE_BUFFER_SHIFT);
+        completion.data = ring->buffers + (size_t)buffer * ring->buffer_size;
+    }
+
+    if ((request->op == GS_URING_OP_ACCEPT) && (result >= 0)) {
+        struct gs_socket_t *client = gs_socket_create(request->gsocket->domain);
+
+        if (client) {
+            client->base->init(client);
+            client->fd = result;
+            completion.client = client;
+
+            /* Like gs_accept(), the client's offer is taken by its first gs_send()/gs_recv(). */
+            if (request->gsocket->flags & GS_SOCKET_FLAG_SHM) {
+                client->flags |= GS_SOCKET_FLAG_SHM_PENDING;
+            }
+
+            if (gs_socket_inherit_opts(client, request->gsocket) < 0) {
+                gs_close(client);
+                completion.client = NULL;
+                completion.result = -errno;
+            }
+        }
+        else {
+            close(result);
+            completion.result = -ENOMEM;
+        }
+    }
+    else if ((request->op == GS_URING_OP_CONNECT) && (result >= 0)) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+
+        if (getsockopt(request->gsocket->fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0) {
+            error = errno;
+        }
+
+        completion.result = -error;
+    }
+
+    const gs_uring_handler_t handler = request->handler;
+    void *user_data = request->user_data;
+
+    /* Released first so the handler can queue follow-up work with the same slot. */
+    if (!completion.more) {
+        gs_uring_request_free(ring, request);
+    }
+
+    if (handler) {
+        handler(ring, &completion, user_data);
+    }
+
+    /* Lost buffers would shrink the group for good, each one is pending here at most once. */
+    if ((buffer >= 0) && (gs_uring_provide(ring, (unsigned int)buffer, 1) < 0)) {
+        ring->unprovided[ring->unprovided_count++] = (unsigned short)buffer;
+    }
+}
+
+int gs_uring_run_once(struct gs_uring_t *ring, int timeout)
+{
+    while (ring->unprovided_count) {
+        if (gs_uring_provide(ring, ring->unprovided[ring->unprovided_count - 1], 1) < 0) {
+            break;
+        }
+
+        --ring->unprovided_count;
+    }
+
+    unsigned int head = *ring->cq_head;
+
+    if (ring->pending || (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))) {
+        const bool wait = (timeout != 0) && (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE));
+
+        if (gs_uring_enter(ring, wait ? 1 : 0, timeout) < 0) {
+            return -1;
+        }
+    }
+
+    int completions = 0;
+
+    while (true) {
+        while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+            const struct io_uring_cqe cqe = ring->cqes[head & ring->cq_mask];
+
+            ++head;
+            __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+            if (!cqe.user_data) {
+                continue;
+            }
+
+            gs_uring_complete(ring, (struct gs_uring_request_t *)(uintptr_t)cqe.user_data, cqe.res, cqe.flags);
+            ++completions;
+        }
+
+        /* Completions the CQ had no room for wait in the kernel until it is entered again. */
+        if (!(__atomic_load_n(ring->sq_flags, __ATOMIC_ACQUIRE) & IORING_SQ_CQ_OVERFLOW)) {
+            break;
+        }
+
+        if (gs_uring_enter(ring, 0, 0) < 0) {
+            return -1;
+        }
+    }
+
+    return completions;
+}
@@ -0,0 +1,90 @@
+#ifndef GS_URING_H_
+#define GS_URING_H_
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct gs_socket_t;
+struct gs_uring_t;
+
+enum
+{
+    GS_URING_OP_ACCEPT = 1,
+    GS_URING_OP_CONNECT,
+    GS_URING_OP_SEND,
+    GS_URING_OP_RECV
+};
+
+struct gs_uring_completion_t
+{
+    int op;
+    struct gs_socket_t *gsocket;
+
+    /* Bytes transferred, the client descriptor for accept, 0 for a finished connect, or a negated errno. */
+    int result;
+
+    /* GS_URING_OP_ACCEPT: the new client, owned by the handler from now on. */
+    struct gs_socket_t *client;
+
+    /* GS_URING_OP_RECV: the received bytes. Pool buffers are recycled once the handler returns. */
+    const void *data;
+
+    /* Set while a multishot request stays armed. */
+    bool more;
+};
+
+typedef void (*gs_uring_handler_t)(struct gs_uring_t *ring, const struct gs_uring_completion_t *completion, void *user_data);
+
+/**
+ * Creates an io_uring instance with `entries` submission slots, which also
+ * bound the requests in flight, four times as many completion slots, and a pool
+ * of `buffers` buffers of `buffer_size` bytes handed to the kernel for
+ * multishot receives (no pool when `buffers` is 0).
+ */
+struct gs_uring_t * gs_uring_create(unsigned int entries, unsigned int buffers, unsigned int buffer_size);
+
+void gs_uring_destroy(struct gs_uring_t *ring);
+
+/* Multishot accept, one completion per client until an error ends it. */
+int gs_uring_accept(struct gs_uring_t *ring, struct gs_socket_t *gsocket, gs_uring_handler_t handler, void *user_data);
+
+/* Starts a non-blocking connect and completes once it is established or has failed. */
+int gs_uring_connect(struct gs_uring_t *ring, struct gs_socket_t *gsocket, const char *address, gs_uring_handler_t handler, void *user_data);
+
+/**
+ * `data` must stay valid until the completion. Sends and receives fail
+ * with EOPNOTSUPP on shared-memory connections, which keep their data out
+ * of the socket; use gs_send()/gs_recv() on those.
+ */
+int gs_uring_send(struct gs_uring_t *ring, struct gs_socket_t *gsocket, const void *data, unsigned int length, int flags, gs_uring_handler_t handler, void *user_data);
+
+int gs_uring_recv(struct gs_uring_t *ring, struct gs_socket_t *gsocket, void *data, unsigned int length, int flags, gs_uring_handler_t handler, void *user_data);
+
+/**
+ * Multishot receive into the buffer pool, one completion per chunk. It ends
+ * with result 0 on EOF, or -ENOBUFS when the pool ran dry, in which case it
+ * can simply be armed again.
+ */
+int gs_uring_recv_multishot(struct gs_uring_t *ring, struct gs_socket_t *gsocket, gs_uring_handler_t handler, void *user_data);
+
+/**
+ * Cancels every request on the socket, each one still completes (with
+ * -ECANCELED). The socket must not be closed before its last completion.
+ */
+int gs_uring_cancel(struct gs_uring_t *ring, struct gs_socket_t *gsocket);
+
+/**
+ * Submits the queued requests and dispatches completions, with a single
+ * io_uring_enter() when work is ready. `timeout` is in milliseconds, -1
+ * waits forever. Returns the number of completions handled.
+ */
+int gs_uring_run_once(struct gs_uring_t *ring, int timeout);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* GS_URING_H_ */
@@ -0,0 +1,174 @@
+#include "worker.h"
+#include "queue.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+struct gs_worker_t
+{
+    struct gs_worker_pool_t *pool;
+    unsigned int index;
+
+    struct gs_queue_t *queue;
+    pthread_t thread;
+    bool running;
+};
+
+struct gs_worker_pool_t
+{
+    gs_worker_handler_t handler;
+    void *user_data;
+
+    /* One token per queued socket, plus one per worker on shutdown. */
+    sem_t pending;
+    int stopping;
+    unsigned int next;
+
+    unsigned int workers_size;
+    struct gs_worker_t *workers;
+};
+
+/* Tries the worker's own queue first, then steals from the others. */
+static bool gs_worker_take(struct gs_worker_t *worker, void **item)
+{
+    struct gs_worker_pool_t *pool = worker->pool;
+
+    for (unsigned int offset = 0; offset < pool->workers_size; ++offset) {
+        const unsigned int index = (worker->index + offset) % pool->workers_size;
+
+        if (gs_queue_pop(pool->workers[index].queue, item) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void * gs_worker_routine(void *user_data)
+{
+    struct gs_worker_t *worker = (struct gs_worker_t *)user_data;
+    struct gs_worker_pool_t *pool = worker->pool;
+
+    while (true) {
+        if (sem_wait(&pool->pending) < 0) {
+            continue;
+        }
+
+        void *item = NULL;
+
+        /* A token guarantees a published socket unless the pool is stopping,
+         * it may just have been taken from another queue meanwhile. */
+        while (!gs_worker_take(worker, &item)) {
+            if (__atomic_load_n(&pool->stopping, __ATOMIC_ACQUIRE)) {
+                return NULL;
+            }
+        }
+
+        pool->handler((struct gs_socket_t *)item, pool->user_data);
+    }
+
+    return NULL;
+}
+
+struct gs_worker_pool_t * gs_worker_pool_create(unsigned int threads, unsigned int capacity, gs_worker_handler_t handler, void *user_data)
+{
+    if (!threads || !capacity || !handler) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    struct gs_worker_pool_t *pool = (struct gs_worker_pool_t *)malloc(sizeof(struct gs_worker_pool_t));
+
+    if (!pool) {
+        return NULL;
+    }
+
+    memset(pool, 0, sizeof(struct gs_worker_pool_t));
+
+    pool->handler = handler;
+    pool->user_data = user_data;
+    pool->workers = (struct gs_worker_t *)calloc(threads, sizeof(struct gs_worker_t));
+
+    if (!pool->workers || (sem_init(&pool->pending, 0, 0) < 0)) {
+        free(pool->workers);
+        free(pool);
+        return NULL;
+    }
+
+    pool->workers_size = threads;
+
+    for (unsigned int index = 0; index < threads; ++index) {
+        struct gs_worker_t *worker = pool->workers + index;
+
+        worker->pool = pool;
+        worker->index = index;
+        worker->queue = gs_queue_create(capacity);
+
+        if (!worker->queue) {
+            gs_worker_pool_destroy(pool);
+            return NULL;
+        }
+    }
+
+    for (unsigned int index = 0; index < threads; ++index) {
+        struct gs_worker_t *worker = pool->workers + index;
+
+        if (pthread_create(&worker->thread, NULL, gs_worker_routine, worker) != 0) {
+            gs_worker_pool_destroy(pool);
+            return NULL;
+        }
+
+        worker->running = true;
+    }
+
+    return pool;
+}
+
+int gs_worker_pool_submit(struct gs_worker_pool_t *pool, struct gs_socket_t *gsocket)
+{
+    const unsigned int start = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED);
+
+    for (unsigned int offset = 0; offset < pool->workers_size; ++offset) {
+        const unsigned int index = (start + offset) % pool->workers_size;
+
+        if (gs_queue_push(pool->workers[index].queue, gsocket) == 0) {
+            sem_post(&pool->pending);
+            return 0;
+        }
+    }
+
+    errno = EAGAIN;
+    return -1;
+}
+
+void gs_worker_pool_destroy(struct gs_worker_pool_t *pool)
+{
+    if (!pool) {
+        return;
+    }
+
+    __atomic_store_n(&pool->stopping, 1, __ATOMIC_RELEASE);
+
+    for (unsigned int index = 0; index < pool->workers_size; ++index) {
+        sem_post(&pool->pending);
+    }
+
+    for (unsigned int index = 0; index < pool->workers_size; ++index) {
+        if (pool->workers[index].running) {
+            pthread_join(pool->workers[index].thread, NULL);
+        }
+    }
+
+    for (unsigned int index = 0; index < pool->workers_size; ++index) {
+        gs_queue_destroy(pool->workers[index].queue);
+    }
+
+    sem_destroy(&pool->pending);
+
+    free(pool->workers);
+    free(pool);
+}
@@ -0,0 +1,30 @@
+#ifndef GS_WORKER_H_
+#define GS_WORKER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct gs_socket_t;
+struct gs_worker_pool_t;
+
+/* Runs on a worker thread for each submitted socket. */
+typedef void (*gs_worker_handler_t)(struct gs_socket_t *gsocket, void *user_data);
+
+/**
+ * Fixed number of threads, each owning a bounded lock-free queue of
+ * `capacity` sockets. Idle workers steal from the queues of busy ones.
+ */
+struct gs_worker_pool_t * gs_worker_pool_create(unsigned int threads, unsigned int capacity, gs_worker_handler_t handler, void *user_data);
+
+/* Returns -1 with errno EAGAIN when every queue is full. */
+int gs_worker_pool_submit(struct gs_worker_pool_t *pool, struct gs_socket_t *gsocket);
+
+/* Handles the sockets still queued, then joins the workers. */
+void gs_worker_pool_destroy(struct gs_worker_pool_t *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* GS_WORKER_H_ */
@@ -0,0 +1,334 @@
+#include "write_queue.h"
+#include "socket.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+/* Segments gathered into a single sendmsg(). */
+#define GS_WRITE_QUEUE_IOV 64
+
+/* Size of the blocks gs_write() copies into. */
+#define GS_WRITE_QUEUE_BLOCK_SIZE (16 * 1024)
+
+#define GS_WRITE_QUEUE_INITIAL_SEGMENTS 16
+
+struct gs_write_segment_t
+{
+    char *data;
+    unsigned int length;
+    unsigned int offset;
+
+    /* Non-zero for blocks owned by the queue, the room left for coalescing. */
+    unsigned int capacity;
+
+    gs_write_release_t release;
+    void *user_data;
+};
+
+struct gs_write_queue_t
+{
+    /* Ring of segments, `head` is the next one to send. */
+    struct gs_write_segment_t *segments;
+    unsigned int mask;
+    unsigned int head;
+    unsigned int size;
+
+    size_t pending;
+    size_t low_watermark;
+    size_t high_watermark;
+    bool above;
+
+    gs_write_queue_handler_t handler;
+    void *user_data;
+
+    /* One recycled block to avoid malloc()/free() per drain. */
+    char *spare;
+};
+
+static void gs_write_segment_release(struct gs_write_queue_t *queue, struct gs_write_segment_t *segment)
+{
+    if (segment->capacity) {
+        if (!queue->spare && (segment->capacity == GS_WRITE_QUEUE_BLOCK_SIZE)) {
+            queue->spare = segment->data;
+        }
+        else {
+            free(segment->data);
+        }
+    }
+    else if (segment->release) {
+        segment->release(segment->data, segment->length, segment->user_data);
+    }
+}
+
+void gs_write_queue_destroy(struct gs_write_queue_t *queue)
+{
+    if (!queue) {
+        return;
+    }
+
+    for (unsigned int index = 0; index < queue->size; ++index) {
+        gs_write_segment_release(queue, queue->segments + ((queue->head + index) & queue->mask));
+    }
+
+    free(queue->spare);
+    free(queue->segments);
+    free(queue);
+}
+
+int gs_write_queue_enable(struct gs_socket_t *gsocket, size_t low_watermark, size_t high_watermark, gs_write_queue_handler_t handler, void *user_data)
+{
+    if (gsocket->wq || (low_watermark > high_watermark)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    struct gs_write_queue_t *queue = (struct gs_write_queue_t *)calloc(1, sizeof(struct gs_write_queue_t));
+
+    if (!queue) {
+        return -1;
+    }
+
+    queue->segments = (struct gs_write_segment_t *)malloc(GS_WRITE_QUEUE_INITIAL_SEGMENTS * sizeof(struct gs_write_segment_t));
+
+    if (!queue->segments) {
+        free(queue);
+        return -1;
+    }
+
+    queue->mask = GS_WRITE_QUEUE_INITIAL_SEGMENTS - 1;
+    queue->low_watermark = low_watermark;
+    queue->high_watermark = high_watermark;
+    queue->handler = handler;
+    queue->user_data = user_data;
+
+    gsocket->wq = queue;
+
+    return 0;
+}
+
+static struct gs_write_segment_t * gs_write_queue_push(struct gs_write_queue_t *queue)
+{
+    if (queue->size > queue->mask) {
+        const unsigned int capacity = (queue->mask + 1) * 2;
+        struct gs_write_segment_t *segments = (struct gs_write_segment_t *)malloc(capacity * sizeof(struct gs_write_segment_t));
+
+        if (!segments) {
+            return NULL;
+        }
+
+        for (unsigned int index = 0; index < queue->size; ++index) {
+            segments[index] = queue->segments[(queue->head + index) & queue->mask];
+        }
+
+        free(queue->segments);
+
+        queue->segments = segments;
+        queue->mask = capacity - 1;
+        queue->head = 0;
+    }
+
+    struct gs_write_segment_t *segment = queue->segments + ((queue->head + queue->size) & queue->mask);
+    memset(segment, 0, sizeof(struct gs_write_segment_t));
+
+    ++queue->size;
+
+    return segment;
+}
+
+static void gs_write_queue_grow(struct gs_socket_t *gsocket, unsigned int length)
+{
+    struct gs_write_queue_t *queue = gsocket->wq;
+
+    queue->pending += length;
+
+    if (!queue->above && (queue->pending > queue->high_watermark)) {
+        queue->above = true;
+
+        if (queue->handler) {
+            queue->handler(gsocket, GS_WRITE_QUEUE_HIGH, queue->user_data);
+        }
+    }
+}
+
+int gs_write(struct gs_socket_t *gsocket, const void *data, unsigned int length)
+{
+    struct gs_write_queue_t *queue = gsocket->wq;
+
+    if (!queue) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (!length) {
+        return 0;
+    }
+
+    struct gs_write_segment_t *tail = queue->size ? queue->segments + ((queue->head + queue->size - 1) & queue->mask) : NULL;
+
+    if (!tail || !tail->capacity || (tail->capacity - tail->length < length)) {
+        const unsigned int capacity = (length > GS_WRITE_QUEUE_BLOCK_SIZE) ? length : GS_WRITE_QUEUE_BLOCK_SIZE;
+        char *block = NULL;
+
+        if (queue->spare && (capacity == GS_WRITE_QUEUE_BLOCK_SIZE)) {
+            block = queue->spare;
+            queue->spare = NULL;
+        }
+        else {
+            block = (char *)malloc(capacity);
+        }
+
+        if (!block) {
+            return -1;
+        }
+
+        tail = gs_write_queue_push(queue);
+
+        if (!tail) {
+            free(block);
+            return -1;
+        }
+
+        tail->data = block;
+        tail->capacity = capacity;
+    }
+
+    memcpy(tail->data + tail->length, data, length);
+    tail->length += length;
+
+    gs_write_queue_grow(gsocket, length);
+
+    return (int)length;
+}
+
+int gs_write_ref(struct gs_socket_t *gsocket, const void *data, unsigned int length, gs_write_release_t release, void *user_data)
+{
+    struct gs_write_queue_t *queue = gsocket->wq;
+
+    if (!queue) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    struct gs_write_segment_t *segment = gs_write_queue_push(queue);
+
+    if (!segment) {
+        return -1;
+    }
+
+    segment->data = (char *)data;
+    segment->length = length;
+    segment->release = release;
+    segment->user_data = user_data;
+
+    gs_write_queue_grow(gsocket, length);
+
+    return (int)length;
+}
+
+/* Drops `bytes` sent from the front of the queue. */
+static void gs_write_queue_consume(struct gs_write_queue_t *queue, size_t bytes)
+{
+    queue->pending -= bytes;
+
+    while (bytes && queue->size) {
+        struct gs_write_segment_t *segment = queue->segments + (queue->head & queue->mask);
+        const unsigned int left = segment->length - segment->offset;
+
+        if (bytes < left) {
+            segment->offset += bytes;
+            return;
+        }
+
+        bytes -= left;
+        gs_write_segment_release(queue, segment);
+
+        queue->head = (queue->head + 1) & queue->mask;
+        --queue->size;
+    }
+
+    /* Empty segments queued by reference are released as soon as they reach the front. */
+    while (queue->size) {
+        struct gs_write_segment_t *segment = queue->segments + (queue->head & queue->mask);
+
+        if (segment->length != segment->offset) {
+            break;
+        }
+
+        gs_write_segment_release(queue, segment);
+
+        queue->head = (queue->head + 1) & queue->mask;
+        --queue->size;
+    }
+}
+
+int gs_flush(struct gs_socket_t *gsocket)
+{
+    struct gs_write_queue_t *queue = gsocket->wq;
+
+    if (!queue) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    gs_write_queue_consume(queue, 0);
+
+    while (queue->size) {
+        struct iovec iov[GS_WRITE_QUEUE_IOV];
+        unsigned int count = 0;
+
+        while ((count < queue->size) && (count < GS_WRITE_QUEUE_IOV)) {
+            const struct gs_write_segment_t *segment = queue->segments + ((queue->head + count) & queue->mask);
+
+            iov[count].iov_base = segment->data + segment->offset;
+            iov[count].iov_len = segment->length - segment->offset;
+            ++count;
+        }
+
+        const unsigned long long start = GS_STATS_CLOCK();
+        const int bytes = gsocket->base->sendv(gsocket, iov, count, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+        GS_STATS_RECORD(gsocket, GS_STATS_OP_SEND, bytes, gs_iov_length(iov, count), start);
+
+        if (bytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                break;
+            }
+
+            return -1;
+        }
+
+        gs_write_queue_consume(queue, bytes);
+    }
+
+    if (queue->above && (queue->pending <= queue->low_watermark)) {
+        queue->above = false;
+
+        if (queue->handler) {
+            queue->handler(gsocket, GS_WRITE_QUEUE_LOW, queue->user_data);
+        }
+    }
+
+    if (!queue->size) {
+        return 0;
+    }
+
+    /* A one-shot socket belongs to its handler until it re-arms it, gs_loop_rearm() adds the output interest then. */
+    const unsigned int output = gs_socket_output_event(gsocket);
+
+    if (gsocket->loop && !(gsocket->events & (output | GS_LOOP_FLAG_ONESHOT))) {
+        gs_loop_rearm(gsocket->loop, gsocket, gsocket->events | output);
+    }
+
+    return 1;
+}
+
+size_t gs_write_queue_pending(struct gs_socket_t *gsocket)
+{
+    return gsocket->wq ? gsocket->wq->pending : 0;
+}
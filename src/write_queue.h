@@ -0,0 +1,50 @@
+#ifndef GS_WRITE_QUEUE_H_
+#define GS_WRITE_QUEUE_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct gs_socket_t;
+
+enum
+{
+    GS_WRITE_QUEUE_HIGH = 1,
+    GS_WRITE_QUEUE_LOW
+};
+
+/* Reports GS_WRITE_QUEUE_HIGH once the queued bytes exceed the high watermark, and GS_WRITE_QUEUE_LOW once they drop back to the low one. */
+typedef void (*gs_write_queue_handler_t)(struct gs_socket_t *gsocket, int level, void *user_data);
+
+/* Called once data queued by gs_write_ref() has been sent or discarded. */
+typedef void (*gs_write_release_t)(const void *data, unsigned int length, void *user_data);
+
+/**
+ * Gives the socket an output queue. Queued data is sent by gs_flush(), or
+ * automatically when a socket registered in a gs_loop becomes writable.
+ */
+int gs_write_queue_enable(struct gs_socket_t *gsocket, size_t low_watermark, size_t high_watermark, gs_write_queue_handler_t handler, void *user_data);
+
+/* Copies the data into the queue, small writes are coalesced into shared blocks. */
+int gs_write(struct gs_socket_t *gsocket, const void *data, unsigned int length);
+
+/* Queues the data by reference, it must stay valid until `release` is called. */
+int gs_write_ref(struct gs_socket_t *gsocket, const void *data, unsigned int length, gs_write_release_t release, void *user_data);
+
+/**
+ * Sends as much of the queue as the socket accepts without blocking, with
+ * one writev() per 64 segments. Returns 0 once drained, 1 if data is left
+ * (the socket will be watched for writability when it is in a loop), -1
+ * on error.
+ */
+int gs_flush(struct gs_socket_t *gsocket);
+
+size_t gs_write_queue_pending(struct gs_socket_t *gsocket);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* GS_WRITE_QUEUE_H_ */
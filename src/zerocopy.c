@@ -0,0 +1,83 @@
+#include "zerocopy.h"
+#include "socket.h"
+
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+
+int gs_zerocopy_enable(struct gs_socket_t *gsocket)
+{
+    if ((gsocket->domain != GS_SOCKET_DOMAIN_TCP) && (gsocket->domain != GS_SOCKET_DOMAIN_UDP)) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    const int enable = 1;
+
+    return setsockopt(gsocket->fd, SOL_SOCKET, SO_ZEROCOPY, &enable, sizeof(enable));
+}
+
+int gs_send_zerocopy(struct gs_socket_t *gsocket, const void *data, unsigned int length, int flags, unsigned int *id)
+{
+    const int bytes = gsocket->base->send(gsocket, data, length, flags | MSG_ZEROCOPY);
+
+    /* The kernel numbers every successful MSG_ZEROCOPY call on the socket. */
+    if (bytes >= 0) {
+        if (id) {
+            *id = gsocket->zerocopy_next;
+        }
+
+        ++gsocket->zerocopy_next;
+    }
+
+    return bytes;
+}
+
+int gs_zerocopy_reap(struct gs_socket_t *gsocket, gs_zerocopy_handler_t handler, void *user_data)
+{
+    int completions = 0;
+
+    while (true) {
+        char control[CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in6))];
+
+        struct msghdr message_header;
+        memset(&message_header, 0, sizeof(struct msghdr));
+        message_header.msg_control = control;
+        message_header.msg_controllen = sizeof(control);
+
+        if (recvmsg(gsocket->fd, &message_header, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                return completions;
+            }
+
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return completions ? completions : -1;
+        }
+
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message_header); cmsg; cmsg = CMSG_NXTHDR(&message_header, cmsg)) {
+            const bool recverr = ((cmsg->cmsg_level == SOL_IP) && (cmsg->cmsg_type == IP_RECVERR)) ||
+                                 ((cmsg->cmsg_level == SOL_IPV6) && (cmsg->cmsg_type == IPV6_RECVERR));
+
+            if (!recverr) {
+                continue;
+            }
+
+            const struct sock_extended_err *error = (const struct sock_extended_err *)CMSG_DATA(cmsg);
+
+            if ((error->ee_origin != SO_EE_ORIGIN_ZEROCOPY) || (error->ee_errno != 0)) {
+                continue;
+            }
+
+            if (handler) {
+                handler(gsocket, error->ee_info, error->ee_data, (error->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0, user_data);
+            }
+
+            ++completions;
+        }
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef GS_ZEROCOPY_H_
+#define GS_ZEROCOPY_H_
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct gs_socket_t;
+
+/**
+ * Reports that the buffers of the zero-copy sends numbered first..last
+ * (inclusive) can be reused. `copied` is set when the kernel fell back to
+ * copying, in which case zero-copy is not paying off for this route.
+ */
+typedef void (*gs_zerocopy_handler_t)(struct gs_socket_t *gsocket, unsigned int first, unsigned int last, bool copied, void *user_data);
+
+/* Sets SO_ZEROCOPY, only supported by the TCP and UDP domains. */
+int gs_zerocopy_enable(struct gs_socket_t *gsocket);
+
+/**
+ * Sends with MSG_ZEROCOPY; the buffer must not be modified until its
+ * completion is reaped. `id` receives the number identifying this send in
+ * completions. Worth it for payloads of tens of kilobytes and more.
+ */
+int gs_send_zerocopy(struct gs_socket_t *gsocket, const void *data, unsigned int length, int flags, unsigned int *id);
+
+/**
+ * Reads pending completions from the socket error queue without blocking.
+ * A socket in a gs_loop reports them as GS_LOOP_EVENT_ERROR. Returns the
+ * number of completion ranges handled.
+ */
+int gs_zerocopy_reap(struct gs_socket_t *gsocket, gs_zerocopy_handler_t handler, void *user_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* GS_ZEROCOPY_H_ */
@@ -0,0 +1,666 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#include "../src/gs.h"
+
+#define BACKLOG 1024
+#define MAX_MSG_SIZE (64 * 1024)
+#define FANIN_THREADS 4
+
+/* Log-linear histogram: 2^HIST_SUB_BITS buckets per power of two, about 1.5% resolution. */
+#define HIST_SUB_BITS 6
+#define HIST_SUB_COUNT (1U << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS) * HIST_SUB_COUNT)
+
+struct histogram_t
+{
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t max;
+};
+
+struct bench_config_t
+{
+    unsigned int iterations;
+    unsigned int connects;
+    unsigned int connections;
+    unsigned long long stream_bytes;
+    bool json;
+    int port;
+};
+
+struct bench_domain_t
+{
+    const char *name;
+    GS_SOCKET_DOMAIN_TYPE domain;
+};
+
+struct server_t
+{
+    struct gs_socket_t *listener;
+    pthread_t thread;
+    unsigned long long stream_bytes;
+};
+
+static struct bench_config_t config = {
+    .iterations = 100000,
+    .connects = 10000,
+    .connections = 64,
+    .stream_bytes = 256ULL * 1024 * 1024,
+    .json = false,
+    .port = 17000
+};
+
+static void print_usage(const char *binary_name)
+{
+    const char *format = "Usage: %s [options]\n"
+                         "Options:\n"
+                         "    -d <unix|tcp|all>  domains to measure (default all)\n"
+                         "    -i <count>  ping-pong round trips (default 100000)\n"
+                         "    -b <MiB>  bytes streamed per message size (default 256)\n"
+                         "    -n <count>  connections opened by the connection-rate test (default 10000)\n"
+                         "    -c <count>  concurrent connections in the fan-in test (default 64)\n"
+                         "    -p <port>  first TCP port used on 127.0.0.1 (default 17000)\n"
+                         "    -j  print one JSON object per result\n"
+                         "Examples:\n"
+                         "    %s -d tcp -j\n"
+                         "\n";
+
+    printf(format, binary_name, binary_name);
+}
+
+static inline uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static unsigned int histogram_bucket(uint64_t value)
+{
+    if (value < HIST_SUB_COUNT) {
+        return (unsigned int)value;
+    }
+
+    const unsigned int magnitude = 63 - __builtin_clzll(value);
+    const unsigned int shift = magnitude - HIST_SUB_BITS;
+
+    return (shift + 1) * HIST_SUB_COUNT + (unsigned int)((value >> shift) & (HIST_SUB_COUNT - 1));
+}
+
+/* Lowest value that falls into the bucket. */
+static uint64_t histogram_value(unsigned int bucket)
+{
+    if (bucket < HIST_SUB_COUNT) {
+        return bucket;
+    }
+
+    const unsigned int shift = bucket / HIST_SUB_COUNT - 1;
+
+    return (uint64_t)(HIST_SUB_COUNT + bucket % HIST_SUB_COUNT) << shift;
+}
+
+static void histogram_record(struct histogram_t *histogram, uint64_t value)
+{
+    ++histogram->counts[histogram_bucket(value)];
+    ++histogram->total;
+
+    if (value > histogram->max) {
+        histogram->max = value;
+    }
+}
+
+static uint64_t histogram_percentile(const struct histogram_t *histogram, double percentile)
+{
+    const uint64_t rank = (uint64_t)(percentile / 100.0 * (double)histogram->total + 0.5);
+    uint64_t seen = 0;
+
+    for (unsigned int bucket = 0; bucket < HIST_BUCKETS; ++bucket) {
+        seen += histogram->counts[bucket];
+
+        if (seen >= rank && seen) {
+            return histogram_value(bucket);
+        }
+    }
+
+    return histogram->max;
+}
+
+static int send_all(struct gs_socket_t *gsocket, const char *data, unsigned int length)
+{
+    while (length) {
+        const int bytes = gs_send(gsocket, data, length, MSG_NOSIGNAL);
+
+        if (bytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return -1;
+        }
+
+        data += bytes;
+        length -= bytes;
+    }
+
+    return 0;
+}
+
+static int recv_all(struct gs_socket_t *gsocket, char *data, unsigned int length)
+{
+    while (length) {
+        const int bytes = gs_recv(gsocket, data, length, 0);
+
+        if (bytes <= 0) {
+            if ((bytes < 0) && (errno == EINTR)) {
+                continue;
+            }
+
+            return -1;
+        }
+
+        data += bytes;
+        length -= bytes;
+    }
+
+    return 0;
+}
+
+static const char * bench_address(const struct bench_domain_t *domain, unsigned int test, char *buffer, unsigned int length)
+{
+    /* Every test gets its own address, TIME_WAIT would keep a reused TCP port busy. */
+    if (domain->domain == GS_SOCKET_DOMAIN_TCP) {
+        snprintf(buffer, length, "127.0.0.1:%d", config.port + (int)test);
+    }
+    else {
+        snprintf(buffer, length, "@gs-bench-%d-%u", (int)getpid(), test);
+    }
+
+    return buffer;
+}
+
+static inline void bench_close(struct gs_socket_t *gsocket)
+{
+    if (gsocket) {
+        gs_close(gsocket);
+    }
+}
+
+static struct gs_socket_t * bench_socket(const struct bench_domain_t *domain)
+{
+    struct gs_socket_t *gsocket = gs_socket(domain->domain);
+
+    if (gsocket) {
+        struct gs_socket_opts_t opts;
+        gs_socket_opts_preset(&opts, GS_SOCKET_PROFILE_LOW_LATENCY);
+        gs_socket_set_opts(gsocket, &opts);
+    }
+
+    return gsocket;
+}
+
+static struct gs_socket_t * bench_connect(const struct bench_domain_t *domain, const char *address)
+{
+    struct gs_socket_t *gsocket = bench_socket(domain);
+
+    if (gsocket && (gs_connect(gsocket, address) < 0)) {
+        bench_close(gsocket);
+        return NULL;
+    }
+
+    return gsocket;
+}
+
+static bool server_start(struct server_t *server, const struct bench_domain_t *domain, const char *address, void *(*routine)(void *))
+{
+    server->listener = bench_socket(domain);
+
+    if (!server->listener || (gs_bind(server->listener, address, BACKLOG) < 0)) {
+        fprintf(stderr, "%s: failed to bind %s: %s\n", domain->name, address, strerror(errno));
+        bench_close(server->listener);
+        return false;
+    }
+
+    return pthread_create(&server->thread, NULL, routine, server) == 0;
+}
+
+static void server_join(struct server_t *server)
+{
+    pthread_join(server->thread, NULL);
+    bench_close(server->listener);
+}
+
+static void report(const struct bench_domain_t *domain, const char *test, unsigned int size, const char *metric, double value, const char *unit)
+{
+    if (config.json) {
+        printf("{\"domain\":\"%s\",\"test\":\"%s\",\"size\":%u,\"metric\":\"%s\",\"value\":%.3f,\"unit\":\"%s\"}\n", domain->name, test, size, metric, value, unit);
+    }
+    else {
+        printf("%-5s %-12s %8u  %-10s %14.3f %s\n", domain->name, test, size, metric, value, unit);
+    }
+}
+
+static void * echo_routine(void *user_data)
+{
+    struct server_t *server = (struct server_t *)user_data;
+    struct gs_socket_t *client = gs_accept(server->listener, NULL, 0);
+    char buffer[MAX_MSG_SIZE];
+
+    while (client) {
+        const int bytes = gs_recv(client, buffer, sizeof(buffer), 0);
+
+        if ((bytes <= 0) || (send_all(client, buffer, bytes) < 0)) {
+            break;
+        }
+    }
+
+    bench_close(client);
+
+    return NULL;
+}
+
+static void bench_pingpong(const struct bench_domain_t *domain, unsigned int size)
+{
+    char address[64];
+    struct server_t server;
+    memset(&server, 0, sizeof(struct server_t));
+
+    if (!server_start(&server, domain, bench_address(domain, 0, address, sizeof(address)), echo_routine)) {
+        return;
+    }
+
+    struct gs_socket_t *gsocket = bench_connect(domain, address);
+    struct histogram_t *histogram = (struct histogram_t *)calloc(1, sizeof(struct histogram_t));
+    char *buffer = (char *)calloc(1, size);
+
+    for (unsigned int index = 0; gsocket && histogram && buffer && (index < config.iterations); ++index) {
+        const uint64_t begin = now_ns();
+
+        if ((send_all(gsocket, buffer, size) < 0) || (recv_all(gsocket, buffer, size) < 0)) {
+            fprintf(stderr, "%s: ping-pong failed: %s\n", domain->name, strerror(errno));
+            break;
+        }
+
+        histogram_record(histogram, now_ns() - begin);
+    }
+
+    bench_close(gsocket);
+    server_join(&server);
+
+    if (histogram && histogram->total) {
+        const double percentiles[] = {50.0, 90.0, 99.0, 99.9, 99.99};
+        const char *names[] = {"p50", "p90", "p99", "p99.9", "p99.99"};
+
+        for (unsigned int index = 0; index < sizeof(percentiles) / sizeof(percentiles[0]); ++index) {
+            report(domain, "pingpong", size, names[index], histogram_percentile(histogram, percentiles[index]) / 1000.0, "us");
+        }
+
+        report(domain, "pingpong", size, "max", histogram->max / 1000.0, "us");
+    }
+
+    free(buffer);
+    free(histogram);
+}
+
+static void * sink_routine(void *user_data)
+{
+    struct server_t *server = (struct server_t *)user_data;
+    struct gs_socket_t *client = gs_accept(server->listener, NULL, 0);
+    char buffer[MAX_MSG_SIZE];
+    unsigned long long received = 0;
+
+    while (client && (received < server->stream_bytes)) {
+        const int bytes = gs_recv(client, buffer, sizeof(buffer), 0);
+
+        if (bytes <= 0) {
+            break;
+        }
+
+        received += bytes;
+    }
+
+    /* The acknowledgement ends the measurement once everything arrived. */
+    if (client) {
+        send_all(client, "", 1);
+    }
+
+    bench_close(client);
+
+    return NULL;
+}
+
+static void bench_stream(const struct bench_domain_t *domain, unsigned int size, unsigned int test)
+{
+    char address[64];
+    struct server_t server;
+    memset(&server, 0, sizeof(struct server_t));
+
+    const unsigned long long messages = config.stream_bytes / size;
+    server.stream_bytes = messages * size;
+
+    if (!server_start(&server, domain, bench_address(domain, test, address, sizeof(address)), sink_routine)) {
+        return;
+    }
+
+    struct gs_socket_t *gsocket = bench_connect(domain, address);
+    char *buffer = (char *)calloc(1, size);
+    bool ok = gsocket && buffer;
+
+    const uint64_t begin = now_ns();
+
+    for (unsigned long long index = 0; ok && (index < messages); ++index) {
+        ok = (send_all(gsocket, buffer, size) == 0);
+    }
+
+    char ack = 0;
+    ok = ok && (recv_all(gsocket, &ack, 1) == 0);
+
+    const double seconds = (now_ns() - begin) / 1e9;
+
+    bench_close(gsocket);
+    server_join(&server);
+    free(buffer);
+
+    if (!ok) {
+        fprintf(stderr, "%s: stream of %u-byte messages failed: %s\n", domain->name, size, strerror(errno));
+        return;
+    }
+
+    report(domain, "stream", size, "throughput", server.stream_bytes / seconds / (1024.0 * 1024.0), "MiB/s");
+    report(domain, "stream", size, "rate", messages / seconds, "msg/s");
+}
+
+static void * accept_routine(void *user_data)
+{
+    struct server_t *server = (struct server_t *)user_data;
+
+    for (unsigned int index = 0; index < config.connects; ++index) {
+        struct gs_socket_t *client = gs_accept(server->listener, NULL, 0);
+
+        if (!client) {
+            break;
+        }
+
+        bench_close(client);
+    }
+
+    return NULL;
+}
+
+static void bench_connect_rate(const struct bench_domain_t *domain)
+{
+    char address[64];
+    struct server_t server;
+    memset(&server, 0, sizeof(struct server_t));
+
+    if (!server_start(&server, domain, bench_address(domain, 100, address, sizeof(address)), accept_routine)) {
+        return;
+    }
+
+    struct gs_addr_t *resolved = gs_addr_resolve(domain->domain, address);
+    unsigned int connected = 0;
+
+    const uint64_t begin = now_ns();
+
+    for (; resolved && (connected < config.connects); ++connected) {
+        struct gs_socket_t *gsocket = bench_socket(domain);
+
+        if (!gsocket || (gs_connect_addr(gsocket, resolved) < 0)) {
+            fprintf(stderr, "%s: connect failed: %s\n", domain->name, strerror(errno));
+            bench_close(gsocket);
+            break;
+        }
+
+        bench_close(gsocket);
+    }
+
+    const double seconds = (now_ns() - begin) / 1e9;
+
+    /* Wakes the acceptor up if the loop ended early. */
+    if (connected < config.connects) {
+        shutdown(gs_raw_fd(server.listener), SHUT_RDWR);
+    }
+
+    server_join(&server);
+    gs_addr_destroy(resolved);
+
+    report(domain, "connect", 0, "rate", connected / seconds, "conn/s");
+}
+
+static void fanin_handler(struct gs_loop_t *loop, struct gs_socket_t *gsocket, unsigned int events, void *user_data)
+{
+    (void)loop;
+    (void)user_data;
+
+    char buffer[MAX_MSG_SIZE];
+
+    if (!(events & GS_LOOP_EVENT_READABLE)) {
+        return;
+    }
+
+    /* Edge-triggered, so read until the socket is drained. */
+    while (true) {
+        const int bytes = gs_recv(gsocket, buffer, sizeof(buffer), 0);
+
+        if (bytes > 0) {
+            send_all(gsocket, buffer, bytes);
+            continue;
+        }
+
+        if ((bytes < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+            return;
+        }
+
+        bench_close(gsocket);
+        return;
+    }
+}
+
+static void fanin_accept(struct gs_loop_t *loop, struct gs_socket_t *gsocket, unsigned int events, void *user_data)
+{
+    (void)events;
+    (void)user_data;
+
+    struct gs_socket_t *clients[64];
+    int count = 0;
+
+    while ((count = gs_accept_batch(gsocket, clients, NULL, 64, GS_ACCEPT_NONBLOCK | GS_ACCEPT_CLOEXEC)) > 0) {
+        for (int index = 0; index < count; ++index) {
+            if (gs_loop_add(loop, clients[index], GS_LOOP_EVENT_READABLE, fanin_handler, NULL) < 0) {
+                bench_close(clients[index]);
+            }
+        }
+    }
+}
+
+static void * fanin_server_routine(void *user_data)
+{
+    gs_loop_run((struct gs_loop_t *)user_data);
+
+    return NULL;
+}
+
+struct fanin_client_t
+{
+    const struct bench_domain_t *domain;
+    const char *address;
+    unsigned int connections;
+    unsigned int rounds;
+    unsigned long long requests;
+    pthread_t thread;
+};
+
+/* Each round sends one request on every connection before collecting the responses. */
+static void * fanin_client_routine(void *user_data)
+{
+    struct fanin_client_t *client = (struct fanin_client_t *)user_data;
+    struct gs_socket_t **sockets = (struct gs_socket_t **)calloc(client->connections, sizeof(struct gs_socket_t *));
+    char buffer[64] = {0};
+
+    for (unsigned int index = 0; sockets && (index < client->connections); ++index) {
+        sockets[index] = bench_connect(client->domain, client->address);
+
+        if (!sockets[index]) {
+            fprintf(stderr, "%s: fan-in connect failed: %s\n", client->domain->name, strerror(errno));
+            client->rounds = 0;
+            break;
+        }
+    }
+
+    for (unsigned int round = 0; round < client->rounds; ++round) {
+        for (unsigned int index = 0; index < client->connections; ++index) {
+            send_all(sockets[index], buffer, sizeof(buffer));
+        }
+
+        for (unsigned int index = 0; index < client->connections; ++index) {
+            if (recv_all(sockets[index], buffer, sizeof(buffer)) == 0) {
+                ++client->requests;
+            }
+        }
+    }
+
+    for (unsigned int index = 0; sockets && (index < client->connections); ++index) {
+        bench_close(sockets[index]);
+    }
+
+    free(sockets);
+
+    return NULL;
+}
+
+static void bench_fanin(const struct bench_domain_t *domain)
+{
+    char address[64];
+    struct gs_loop_t *loop = gs_loop_create();
+    struct gs_socket_t *listener = bench_socket(domain);
+
+    if (!loop || !listener || (gs_bind(listener, bench_address(domain, 101, address, sizeof(address)), BACKLOG) < 0) ||
+        (gs_loop_add(loop, listener, GS_LOOP_EVENT_READABLE, fanin_accept, NULL) < 0)) {
+        fprintf(stderr, "%s: fan-in setup failed: %s\n", domain->name, strerror(errno));
+        bench_close(listener);
+        gs_loop_destroy(loop);
+        return;
+    }
+
+    pthread_t server;
+    pthread_create(&server, NULL, fanin_server_routine, loop);
+
+    struct fanin_client_t clients[FANIN_THREADS];
+    const unsigned int rounds = (config.iterations / config.connections) ? (config.iterations / config.connections) : 1;
+
+    const uint64_t begin = now_ns();
+
+    for (unsigned int index = 0; index < FANIN_THREADS; ++index) {
+        memset(clients + index, 0, sizeof(struct fanin_client_t));
+        clients[index].domain = domain;
+        clients[index].address = address;
+        clients[index].connections = config.connections / FANIN_THREADS + (index < config.connections % FANIN_THREADS);
+        clients[index].rounds = rounds;
+
+        pthread_create(&clients[index].thread, NULL, fanin_client_routine, clients + index);
+    }
+
+    unsigned long long requests = 0;
+
+    for (unsigned int index = 0; index < FANIN_THREADS; ++index) {
+        pthread_join(clients[index].thread, NULL);
+        requests += clients[index].requests;
+    }
+
+    const double seconds = (now_ns() - begin) / 1e9;
+
+    gs_loop_stop(loop);
+    pthread_join(server, NULL);
+    bench_close(listener);
+
+    /* The clients hung up already, let the handler close what the loop has not seen go yet. */
+    if (gs_loop_drain(loop, 1000) > 0) {
+        fprintf(stderr, "%s: fan-in connections left open\n", domain->name);
+    }
+
+    gs_loop_destroy(loop);
+
+    report(domain, "fanin", config.connections, "rate", requests / seconds, "req/s");
+}
+
+int main(int argc, char *argv[])
+{
+    const struct bench_domain_t domains[] = {
+        {"unix", GS_SOCKET_DOMAIN_UNIX},
+        {"tcp", GS_SOCKET_DOMAIN_TCP}
+    };
+    const unsigned int domains_size = sizeof(domains) / sizeof(domains[0]);
+
+    const char *selected = "all";
+
+    while (true) {
+        const int charactor = getopt(argc, argv, "d:i:b:n:c:p:j");
+
+        if (charactor == -1) {
+            break;
+        }
+
+        switch (charactor) {
+            case 'd':
+                selected = optarg;
+                break;
+            case 'i':
+                config.iterations = (unsigned int)strtoul(optarg, NULL, 10);
+                break;
+            case 'b':
+                config.stream_bytes = strtoull(optarg, NULL, 10) * 1024 * 1024;
+                break;
+            case 'n':
+                config.connects = (unsigned int)strtoul(optarg, NULL, 10);
+                break;
+            case 'c':
+                config.connections = (unsigned int)strtoul(optarg, NULL, 10);
+                break;
+            case 'p':
+                config.port = atoi(optarg);
+                break;
+            case 'j':
+                config.json = true;
+                break;
+            default:
+                print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (!config.iterations || !config.connections || !config.stream_bytes) {
+        print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    const unsigned int sizes[] = {64, 1024, 16 * 1024, MAX_MSG_SIZE};
+    const unsigned int sizes_size = sizeof(sizes) / sizeof(sizes[0]);
+
+    for (unsigned int index = 0; index < domains_size; ++index) {
+        const struct bench_domain_t *domain = domains + index;
+
+        if (strcmp(selected, "all") && strcmp(selected, domain->name)) {
+            continue;
+        }
+
+        bench_pingpong(domain, 64);
+
+        for (unsigned int size = 0; size < sizes_size; ++size) {
+            bench_stream(domain, sizes[size], 1 + size);
+        }
+
+        bench_connect_rate(domain);
+        bench_fanin(domain);
+    }
+
+    return 0;
+}
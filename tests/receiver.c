@@ -7,18 +7,23 @@
 #include <getopt.h>
 #include <unistd.h>
 #include <errno.h>
-#include <sys/epoll.h>
-#include <pthread.h>
 
 #include "../src/gs.h"
 
 #define MAX_MSG_BUFFER_SIZE 512
 #define BACKLOG 32
-#define MAX_EVENTS 32
-#define TIMEOUT 1000
+#define WORKERS 4
+#define WORKER_QUEUE_SIZE 1024
+#define IDLE_TIMEOUT 60000
+#define RECV_BUFFERS 1024
+#define ACCEPT_RETRY 100
 
-static bool running = false;
-static int epoll_fd = -1;
+static struct gs_loop_t *loop = NULL;
+static struct gs_worker_pool_t *workers = NULL;
+static struct gs_buffer_pool_t *buffers = NULL;
+
+/* Drains the backlog again once descriptors are freed, the listener is edge-triggered. */
+static struct gs_timer_t accept_retry;
 
 static void print_usage(const char *binary_name)
 {
@@ -35,7 +40,7 @@ static void print_usage(const char *binary_name)
 
 static void signal_handler(int number)
 {
-    running = false;
+    gs_loop_stop(loop);
 
     printf("Received a signal: 0x%x\n", number);
 }
@@ -56,16 +61,18 @@ static void reverse(char *string, unsigned int length)
     }
 }
 
-static void * connection_handler(void *user_data)
+static void connection_handler(struct gs_socket_t *client, void *user_data)
 {
-    pthread_detach(pthread_self());
+    (void)user_data;
 
-    struct gs_socket_t *client = (struct gs_socket_t *)user_data;
-    char message[MAX_MSG_BUFFER_SIZE];
+    struct gs_buffer_t *buffer = NULL;
 
-    const int bytes = gs_recv(client, message, sizeof(message), 0);
+    /* Idle clients hold no receive buffer, one is borrowed only when a message arrives. */
+    const int bytes = gs_recv_pooled(client, buffers, &buffer, 0);
 
     if (bytes > 0) {
+        char *message = (char *)buffer->data;
+
         printf("[%p] Receive: '%.*s'\n", (void *)client, bytes, message);
 
         reverse(message, bytes);
@@ -73,58 +80,96 @@ static void * connection_handler(void *user_data)
         printf("[%p] Send: '%.*s'\n", (void *)client, bytes, message);
 
         gs_send(client, message, bytes, 0);
+
+        gs_buffer_release(buffer);
+    }
+
+    if (gs_loop_rearm(loop, client, GS_LOOP_EVENT_READABLE | GS_LOOP_FLAG_ONESHOT) < 0) {
+        printf("gs_loop_rearm() failed: %s(%d).\n", strerror(errno), errno);
     }
+}
+
+static void do_shutdown(struct gs_socket_t *gsocket)
+{
+    printf("Close connection (%p)\n", (void *)gsocket);
 
-    struct epoll_event event;
-    memset(&event, 0, sizeof(struct epoll_event));
-    event.events = EPOLLIN | EPOLLPRI | EPOLLRDHUP;
-    event.data.ptr = client;
+    gs_close(gsocket);
+}
 
-    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, gs_raw_fd(client), &event) < 0) {
-        printf("epoll_ctl() failed: %s(%d).\n", strerror(errno), errno);
-        gs_close(client);
+static void do_handle(struct gs_socket_t *gsocket)
+{
+    if (gs_worker_pool_submit(workers, gsocket) < 0) {
+        connection_handler(gsocket, NULL);
     }
+}
 
-    pthread_exit(NULL);
+static void client_handler(struct gs_loop_t *loop, struct gs_socket_t *gsocket, unsigned int events, void *user_data)
+{
+    (void)loop;
+    (void)user_data;
+
+    if (events & (GS_LOOP_EVENT_HANGUP | GS_LOOP_EVENT_ERROR)) {
+        do_shutdown(gsocket);
+    }
+    else {
+        do_handle(gsocket);
+    }
 }
 
 static void do_accept(struct gs_socket_t *gsocket)
 {
-    struct gs_socket_t *client = gs_accept(gsocket, NULL, 0);
+    while (true) {
+        struct gs_socket_t *client = gs_accept(gsocket, NULL, 0);
 
-    if (client == NULL) {
-        printf("Failed to accept: %s(%d).\n", strerror(errno), errno);
-        return;
-    }
+        if (client == NULL) {
+            /* The client reset before it was accepted, the next one may be fine. */
+            if ((errno == ECONNABORTED) || (errno == EPROTO) || (errno == EINTR)) {
+                continue;
+            }
 
-    printf("New connection (%p)\n", (void *)client);
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                return;
+            }
 
-    struct epoll_event event;
-    memset(&event, 0, sizeof(struct epoll_event));
-    event.events = EPOLLIN | EPOLLPRI | EPOLLRDHUP;
-    event.data.ptr = client;
+            const int error = errno;
 
-    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, gs_raw_fd(client), &event) < 0) {
-        printf("epoll_ctl() failed: %s(%d).\n", strerror(errno), errno);
-        gs_close(client);
+            printf("Failed to accept: %s(%d).\n", strerror(error), error);
+
+            if ((error == EMFILE) || (error == ENFILE) || (error == ENOBUFS) || (error == ENOMEM)) {
+                gs_timer_start(loop, &accept_retry, ACCEPT_RETRY);
+            }
+
+            return;
+        }
+
+        printf("New connection (%p)\n", (void *)client);
+
+        if (gs_loop_add(loop, client, GS_LOOP_EVENT_READABLE | GS_LOOP_FLAG_ONESHOT, client_handler, NULL) < 0) {
+            printf("gs_loop_add() failed: %s(%d).\n", strerror(errno), errno);
+            gs_close(client);
+            continue;
+        }
+
+        /* Idle clients are shut down and then closed by the hangup path. */
+        gs_loop_set_timeouts(loop, client, 0, 0, IDLE_TIMEOUT, GS_LOOP_TIMEOUT_CLOSE);
     }
 }
 
-static void do_shutdown(struct gs_socket_t *gsocket)
+static void listener_handler(struct gs_loop_t *loop, struct gs_socket_t *gsocket, unsigned int events, void *user_data)
 {
-    printf("Close connection (%p)\n", (void *)gsocket);
+    (void)loop;
+    (void)events;
+    (void)user_data;
 
-    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, gs_raw_fd(gsocket), NULL);
-
-    gs_close(gsocket);
+    do_accept(gsocket);
 }
 
-static void do_handle(struct gs_socket_t *gsocket)
+static void accept_retry_handler(struct gs_loop_t *loop, struct gs_timer_t *timer, void *user_data)
 {
-    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, gs_raw_fd(gsocket), NULL);
+    (void)loop;
+    (void)timer;
 
-    pthread_t thread;
-    pthread_create(&thread, NULL, connection_handler, gsocket);
+    do_accept((struct gs_socket_t *)user_data);
 }
 
 static void create_server(GS_SOCKET_DOMAIN_TYPE type, const char *address)
@@ -139,56 +184,19 @@ static void create_server(GS_SOCKET_DOMAIN_TYPE type, const char *address)
         return;
     }
 
-    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
-
-    if (epoll_fd < 0) {
-        printf("Failed to create epoll: %s(%d).\n", strerror(errno), errno);
+    if (gs_loop_add(loop, gsocket, GS_LOOP_EVENT_READABLE, listener_handler, NULL) < 0) {
+        printf("gs_loop_add() failed: %s(%d).\n", strerror(errno), errno);
         gs_close(gsocket);
         return;
     }
 
-    struct epoll_event event;
-    memset(&event, 0, sizeof(struct epoll_event));
-    event.events = EPOLLIN | EPOLLPRI;
-    event.data.ptr = gsocket;
-
-    const int gs_socket_raw_fd = gs_raw_fd(gsocket);
-
-    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, gs_socket_raw_fd, &event) < 0) {
-        printf("epoll_ctl() failed: %s(%d).\n", strerror(errno), errno);
-        close(epoll_fd);
-        gs_close(gsocket);
-        return;
-    }
-
-    struct epoll_event events[MAX_EVENTS];
+    gs_timer_init(&accept_retry, accept_retry_handler, gsocket);
 
     printf("[%p] Waiting for incoming connections ...\n", (void *)gsocket);
 
-    while (running) {
-        const int num_fds = epoll_wait(epoll_fd, events, MAX_EVENTS, TIMEOUT);
-
-        if (num_fds <= 0) {
-            continue;
-        }
-
-        for (int index = 0; index < num_fds; ++index) {
-            if (events[index].events & EPOLLRDHUP) {
-                do_shutdown(events[index].data.ptr);
-            }
-            else if (events[index].data.ptr == gsocket) {
-                do_accept(events[index].data.ptr);
-            }
-            else {
-                do_handle(events[index].data.ptr);
-            }
-        }
-    }
-
-    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, gs_socket_raw_fd, NULL);
-
-    close(epoll_fd);
+    gs_loop_run(loop);
 
+    gs_timer_stop(loop, &accept_retry);
     gs_close(gsocket);
 }
 
@@ -221,7 +229,7 @@ int main(int argc, char *argv[])
 
     const GS_SOCKET_DOMAIN_TYPE type[] = {GS_SOCKET_DOMAIN_UNIX, GS_SOCKET_DOMAIN_TCP};
     const char *protocols[] = {"ipc://", "tcp://"};
-    const unsigned int protocols_size = GS_SOCKET_DOMAIN_AMOUNT;
+    const unsigned int protocols_size = sizeof(protocols) / sizeof(protocols[0]);
 
     unsigned int index = 0;
 
@@ -237,13 +245,28 @@ int main(int argc, char *argv[])
         exit(EXIT_FAILURE);
     }
 
-    running = true;
+    loop = gs_loop_create();
+    workers = gs_worker_pool_create(WORKERS, WORKER_QUEUE_SIZE, connection_handler, NULL);
+    buffers = gs_buffer_pool_create(MAX_MSG_BUFFER_SIZE, RECV_BUFFERS);
+
+    if (!loop || !workers || !buffers) {
+        printf("Failed to create loop: %s(%d).\n", strerror(errno), errno);
+        gs_buffer_pool_destroy(buffers);
+        gs_worker_pool_destroy(workers);
+        gs_loop_destroy(loop);
+        free(address);
+        exit(EXIT_FAILURE);
+    }
 
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
 
     create_server(type[index], address + strlen(protocols[index]));
 
+    gs_worker_pool_destroy(workers);
+    gs_buffer_pool_destroy(buffers);
+    gs_loop_destroy(loop);
+
     printf("Bye ...\n");
 
     free(address);
@@ -87,7 +87,7 @@ int main(int argc, char *argv[])
 
     const GS_SOCKET_DOMAIN_TYPE type[] = {GS_SOCKET_DOMAIN_UNIX, GS_SOCKET_DOMAIN_TCP};
     const char *protocols[] = {"ipc://", "tcp://"};
-    const unsigned int protocols_size = GS_SOCKET_DOMAIN_AMOUNT;
+    const unsigned int protocols_size = sizeof(protocols) / sizeof(protocols[0]);
 
     unsigned int index = 0;
 